@@ -0,0 +1,53 @@
+#include "randomized_queue.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <iterator>
+
+namespace {
+
+randomized_queue<std::uint64_t> make_queue(std::size_t count)
+{
+    randomized_queue<std::uint64_t> queue(42);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        queue.enqueue(i);
+    }
+    return queue;
+}
+
+// whole queue in random order, begin() draws a new permutation every time
+void BM_Iterate(benchmark::State & state)
+{
+    const auto queue = make_queue(state.range(0));
+    for (auto _ : state) {
+        std::uint64_t sum = 0;
+        for (const auto el : queue) {
+            sum += el;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * queue.size());
+}
+
+// first few elements only, cost of begin() does not depend on the size of the queue
+void BM_IterateFirst(benchmark::State & state)
+{
+    const auto queue = make_queue(state.range(0));
+    for (auto _ : state) {
+        auto it = queue.begin();
+        std::uint64_t sum = 0;
+        for (int i = 0; i < 10; ++i, ++it) {
+            sum += *it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * 10);
+}
+
+} // anonymous namespace
+
+BENCHMARK(BM_Iterate)->RangeMultiplier(64)->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_IterateFirst)->RangeMultiplier(64)->Range(1 << 10, 1 << 22);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,261 @@
+#include "concurrent_randomized_queue.h"
+#include "randomized_queue.h"
+#include "weighted_randomized_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// nanoseconds per element of 'count' elements handled by 'run'
+template <class Run>
+double measure(Run && run, std::size_t count)
+{
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+}
+
+// keeps the optimizer from dropping results
+volatile long long sink;
+
+template <class Queue>
+void fill(Queue & queue, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        queue.enqueue(static_cast<int>(i));
+    }
+}
+
+// the whole queue taken out in batches of 'k' against one dequeue() per element
+void dequeue_workload(std::size_t count, std::size_t k)
+{
+    std::vector<int> out(k);
+
+    randomized_queue<int> loop_queue;
+    fill(loop_queue, count);
+    const double loop_ns = measure([&]() {
+        long long sum = 0;
+        while (!loop_queue.empty()) {
+            for (std::size_t i = 0; i < k && !loop_queue.empty(); ++i) {
+                out[i] = loop_queue.dequeue();
+            }
+            sum += out[0];
+        }
+        sink = sum;
+    },
+                                   count);
+
+    randomized_queue<int> batch_queue;
+    fill(batch_queue, count);
+    const double batch_ns = measure([&]() {
+        long long sum = 0;
+        while (!batch_queue.empty()) {
+            batch_queue.dequeue_n(k, out.begin());
+            sum += out[0];
+        }
+        sink = sum;
+    },
+                                    count);
+
+    std::cout << "dequeue by " << k << ": loop " << loop_ns << " ns, dequeue_n " << batch_ns << " ns" << std::endl;
+}
+
+// 'rounds' samples of 'k' elements against 'k' sample() calls
+void sample_workload(std::size_t count, std::size_t k, std::size_t rounds)
+{
+    randomized_queue<int> queue;
+    fill(queue, count);
+    std::vector<int> out(k);
+
+    const double loop_ns = measure([&]() {
+        long long sum = 0;
+        for (std::size_t round = 0; round < rounds; ++round) {
+            for (std::size_t i = 0; i < k; ++i) {
+                out[i] = queue.sample();
+            }
+            sum += out[0];
+        }
+        sink = sum;
+    },
+                                   rounds * k);
+
+    using sampling = randomized_queue<int>::sampling;
+    const auto sample_n_ns = [&](sampling mode) {
+        return measure([&]() {
+            long long sum = 0;
+            for (std::size_t round = 0; round < rounds; ++round) {
+                queue.sample_n(k, out.begin(), mode);
+                sum += out[0];
+            }
+            sink = sum;
+        },
+                       rounds * k);
+    };
+
+    std::cout << "sample " << k << ": loop " << loop_ns << " ns, sample_n with replacement " << sample_n_ns(sampling::with_replacement)
+              << " ns, without replacement " << sample_n_ns(sampling::without_replacement) << " ns" << std::endl;
+}
+
+// one dequeue() per element with 'Engine' behind the queue
+template <class Engine>
+void engine_workload(const std::string & name, std::size_t count)
+{
+    randomized_queue<int, Engine> queue(42);
+    fill(queue, count);
+    const double dequeue_ns = measure([&]() {
+        long long sum = 0;
+        while (!queue.empty()) {
+            sum += queue.dequeue();
+        }
+        sink = sum;
+    },
+                                      count);
+    std::cout << name << ": dequeue " << dequeue_ns << " ns" << std::endl;
+}
+
+// weighted queue: enqueue, weight change, sample and dequeue of every element, all O(log n)
+void weighted_workload(std::size_t count)
+{
+    weighted_randomized_queue<int> queue(42);
+    std::vector<weighted_randomized_queue<int>::handle> handles(count);
+    const double enqueue_ns = measure([&]() {
+        for (std::size_t i = 0; i < count; ++i) {
+            handles[i] = queue.enqueue(static_cast<int>(i), 1.0 + i % 100);
+        }
+    },
+                                      count);
+    const double set_weight_ns = measure([&]() {
+        for (std::size_t i = 0; i < count; ++i) {
+            queue.set_weight(handles[i], 1.0 + (i * 7) % 100);
+        }
+    },
+                                         count);
+    const double sample_ns = measure([&]() {
+        long long sum = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            sum += queue.sample();
+        }
+        sink = sum;
+    },
+                                     count);
+    const double dequeue_ns = measure([&]() {
+        long long sum = 0;
+        while (!queue.empty()) {
+            sum += queue.dequeue();
+        }
+        sink = sum;
+    },
+                                      count);
+    std::cout << "weighted: enqueue " << enqueue_ns << " ns, set_weight " << set_weight_ns << " ns, sample " << sample_ns
+              << " ns, dequeue " << dequeue_ns << " ns" << std::endl;
+}
+
+// stream of 'count' elements into a reservoir of 'capacity' against keeping all of them
+void reservoir_workload(std::size_t count, std::size_t capacity)
+{
+    randomized_queue<int> all(42);
+    const double all_ns = measure([&]() { fill(all, count); }, count);
+    randomized_queue<int> sample(additionals::reservoir{capacity}, 42);
+    const double reservoir_ns = measure([&]() { fill(sample, count); }, count);
+    std::cout << "enqueue: all " << all_ns << " ns, reservoir of " << capacity << " " << reservoir_ns << " ns" << std::endl;
+}
+
+// a randomized_queue behind one mutex, what using it from many threads took so far
+class locked_randomized_queue
+{
+public:
+    void enqueue(int el)
+    {
+        std::lock_guard lock(m_mutex);
+        m_queue.enqueue(el);
+    }
+
+    std::optional<int> try_dequeue()
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_queue.empty()) {
+            return std::nullopt;
+        }
+        return m_queue.dequeue();
+    }
+
+private:
+    std::mutex m_mutex;
+    randomized_queue<int> m_queue;
+};
+
+// throughput of 'threads' threads each enqueueing one element and dequeueing one in turn, queue starts with 'count'
+template <class Queue>
+double concurrent_throughput(Queue & queue, std::size_t count, std::size_t threads)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        queue.enqueue(static_cast<int>(i));
+    }
+    std::atomic<bool> stop = false;
+    std::atomic<std::size_t> ops = 0;
+    std::atomic<long long> total = 0; // sink is written by the calling thread only
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() {
+            std::size_t count = 0;
+            long long sum = 0;
+            for (; !stop.load(std::memory_order_relaxed); count += 2) {
+                queue.enqueue(static_cast<int>(i));
+                sum += queue.try_dequeue().value_or(0);
+            }
+            total += sum;
+            ops += count;
+        });
+    }
+    const auto duration = std::chrono::milliseconds(300);
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto & worker : workers) {
+        worker.join();
+    }
+    sink = total;
+    return ops / std::chrono::duration<double>(duration).count() / 1e6;
+}
+
+void concurrent_workload(std::size_t count, std::size_t threads)
+{
+    locked_randomized_queue locked;
+    const double locked_mops = concurrent_throughput(locked, count, threads);
+    concurrent_randomized_queue<int> sharded;
+    const double sharded_mops = concurrent_throughput(sharded, count, threads);
+    std::cout << "concurrent, " << threads << " threads: one mutex " << locked_mops << " M ops/s, concurrent_randomized_queue "
+              << sharded_mops << " M ops/s" << std::endl;
+}
+
+} // anonymous namespace
+
+// usage: benchmark [number of elements], nanoseconds are per element
+int main(int argc, char ** argv)
+{
+    const std::size_t count = argc > 1 ? std::stoul(argv[1]) : 10'000'000;
+    std::cout << "-- " << count << " elements" << std::endl;
+    engine_workload<std::mt19937>("std::mt19937", count);
+    engine_workload<std::mt19937_64>("std::mt19937_64", count);
+    engine_workload<additionals::xoshiro256starstar>("xoshiro256**", count);
+    for (const std::size_t k : {16, 256, 4096}) {
+        dequeue_workload(count, k);
+    }
+    for (const std::size_t k : {16, 256, 4096}) {
+        sample_workload(count, k, count / k);
+    }
+    weighted_workload(count);
+    reservoir_workload(count, 1000);
+    for (const std::size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        concurrent_workload(count / 10, threads);
+    }
+}
@@ -0,0 +1,412 @@
+#include "concurrent_randomized_queue.h"
+#include "randomized_queue.h"
+#include "weighted_randomized_queue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// checks of randomized_queue, any failure aborts
+// random ones run on fixed seeds and allow 5 standard deviations, so they give the same answer on every run
+
+namespace {
+
+void check(bool condition, const char * what)
+{
+    if (!condition) {
+        std::cerr << "check failed: " << what << std::endl;
+        std::abort();
+    }
+}
+
+// every count within 5 standard deviations of the binomial expectation
+void check_uniform(const std::vector<std::size_t> & counts, std::size_t draws, const char * what)
+{
+    const double p = 1.0 / counts.size();
+    const double expected = draws * p;
+    const double deviation = std::sqrt(draws * p * (1 - p));
+    for (const auto count : counts) {
+        check(std::abs(count - expected) <= 5 * deviation, what);
+    }
+}
+
+randomized_queue<int> make_queue(int count, std::uint64_t seed)
+{
+    randomized_queue<int> queue(seed);
+    for (int i = 0; i < count; ++i) {
+        queue.enqueue(i);
+    }
+    return queue;
+}
+
+bool is_permutation_of_range(std::vector<int> values, int count)
+{
+    std::sort(values.begin(), values.end());
+    std::vector<int> range(count);
+    std::iota(range.begin(), range.end(), 0);
+    return values == range;
+}
+
+// bijection of [0, size) for sizes around powers of two and every key tried
+void check_permutation()
+{
+    std::vector<std::size_t> sizes;
+    for (std::size_t size = 0; size <= 70; ++size) {
+        sizes.push_back(size);
+    }
+    for (std::size_t size : {255, 256, 257, 1000, 4095, 4097, (1 << 16) + 3}) {
+        sizes.push_back(size);
+    }
+    for (const auto size : sizes) {
+        for (const std::uint64_t key : {0ull, 1ull, 0x9e3779b97f4a7c15ull, ~0ull}) {
+            const additionals::random_permutation permutation(size, key);
+            std::vector<bool> hit(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                const std::size_t value = permutation(i);
+                check(value < size && !hit[value], "permutation is a bijection");
+                hit[value] = true;
+            }
+        }
+    }
+}
+
+// every element once per walk, copies of an iterator walk the same order, begin() draws a new one
+void check_iteration()
+{
+    const auto queue = make_queue(1000, 1);
+    const auto begin = queue.begin();
+    const std::vector<int> first(begin, queue.end());
+    check(is_permutation_of_range(first, 1000), "iteration visits every element once");
+    check(std::vector<int>(begin, queue.end()) == first, "copies walk the same order");
+    check(std::vector<int>(queue.begin(), queue.end()) != first, "begin() draws a new order");
+    check(std::distance(queue.begin(), queue.end()) == 1000, "iteration length");
+
+    auto changed = make_queue(10, 2);
+    for (auto & el : changed) {
+        el += 10;
+    }
+    std::vector<int> values;
+    while (!changed.empty()) {
+        values.push_back(changed.dequeue() - 10);
+    }
+    check(is_permutation_of_range(values, 10), "iteration by reference");
+
+    const randomized_queue<int> empty;
+    check(empty.begin() == empty.end(), "iteration of empty queue");
+
+    // any element comes first equally often
+    constexpr int count = 7;
+    constexpr std::size_t draws = 70'000;
+    const auto small = make_queue(count, 3);
+    std::vector<std::size_t> first_counts(count);
+    for (std::size_t i = 0; i < draws; ++i) {
+        ++first_counts[*small.begin()];
+    }
+    check_uniform(first_counts, draws, "first element of iteration is uniform");
+}
+
+// dequeue_n takes distinct elements out, sample_n copies them and leaves the queue as it is
+void check_batches()
+{
+    for (const std::size_t k : {0, 1, 63, 64, 65, 500, 1000, 1500}) {
+        auto queue = make_queue(1000, 4);
+        std::vector<int> taken;
+        queue.dequeue_n(k, std::back_inserter(taken));
+        check(taken.size() == std::min<std::size_t>(k, 1000) && queue.size() == 1000 - taken.size(), "dequeue_n sizes");
+        std::vector<int> all = taken;
+        while (!queue.empty()) {
+            all.push_back(queue.dequeue());
+        }
+        check(is_permutation_of_range(all, 1000), "dequeue_n takes distinct elements out");
+
+        const auto source = make_queue(1000, 5);
+        std::vector<int> sampled;
+        source.sample_n(k, std::back_inserter(sampled));
+        check(sampled.size() == std::min<std::size_t>(k, 1000) && source.size() == 1000, "sample_n sizes");
+        std::sort(sampled.begin(), sampled.end());
+        check(std::adjacent_find(sampled.begin(), sampled.end()) == sampled.end(), "sample_n without replacement is distinct");
+
+        std::vector<int> with_replacement;
+        source.sample_n(k, std::back_inserter(with_replacement), randomized_queue<int>::sampling::with_replacement);
+        check(with_replacement.size() == k, "sample_n with replacement takes k");
+        check(std::all_of(with_replacement.begin(), with_replacement.end(), [](int el) { return 0 <= el && el < 1000; }), "sample_n elements");
+    }
+
+    // every element is in a sample equally often, in either mode
+    constexpr int count = 10;
+    constexpr std::size_t rounds = 20'000;
+    const auto queue = make_queue(count, 6);
+    for (const auto mode : {randomized_queue<int>::sampling::without_replacement, randomized_queue<int>::sampling::with_replacement}) {
+        std::vector<std::size_t> counts(count);
+        std::vector<int> sampled;
+        for (std::size_t i = 0; i < rounds; ++i) {
+            sampled.clear();
+            queue.sample_n(3, std::back_inserter(sampled), mode);
+            for (const int el : sampled) {
+                ++counts[el];
+            }
+        }
+        check_uniform(counts, 3 * rounds, "sample_n is uniform");
+    }
+    std::vector<std::size_t> counts(count);
+    for (std::size_t i = 0; i < rounds; ++i) {
+        auto taken = make_queue(count, i);
+        int first;
+        taken.dequeue_n(1, &first);
+        ++counts[first];
+    }
+    check_uniform(counts, rounds, "dequeue_n is uniform");
+
+    randomized_queue<int> empty;
+    std::vector<int> none;
+    empty.dequeue_n(5, std::back_inserter(none));
+    empty.sample_n(5, std::back_inserter(none), randomized_queue<int>::sampling::with_replacement);
+    check(none.empty(), "batches of empty queue");
+}
+
+// everything that comes out of a queue, one call of each kind after another
+template <class Queue>
+std::vector<int> replay(Queue & queue)
+{
+    std::vector<int> out;
+    for (int i = 0; i < 200; ++i) {
+        queue.enqueue(i);
+    }
+    out.insert(out.end(), queue.begin(), queue.end());
+    queue.sample_n(20, std::back_inserter(out));
+    queue.dequeue_n(70, std::back_inserter(out));
+    out.push_back(queue.sample());
+    while (!queue.empty()) {
+        out.push_back(queue.dequeue());
+    }
+    return out;
+}
+
+// same seed and calls give the same elements in the same order, for engines of 64 and 32 bits
+void check_replay()
+{
+    randomized_queue<int> a(42), b(42), c(43);
+    const auto first = replay(a);
+    check(replay(b) == first, "same seed replays");
+    check(replay(c) != first, "other seed differs");
+    a.seed(42);
+    check(replay(a) == first, "seed() restarts the sequence");
+
+    randomized_queue<int, std::mt19937> d(7), e(7);
+    check(replay(d) == replay(e), "same seed replays with std::mt19937");
+}
+
+// bounded draws: wide products and uniform indices over ranges that are not powers of two
+void check_bounded()
+{
+    using additionals::multiply_wide;
+    check(multiply_wide(~0ull, ~0ull) == std::pair<std::uint64_t, std::uint64_t>{~0ull - 1, 1}, "multiply_wide of maxima");
+    check(multiply_wide(1ull << 32, 1ull << 32) == std::pair<std::uint64_t, std::uint64_t>{1, 0}, "multiply_wide carry");
+    check(multiply_wide(0x123456789abcdefull, 0x10) == std::pair<std::uint64_t, std::uint64_t>{0, 0x123456789abcdef0ull}, "multiply_wide low");
+
+    additionals::random_struct<> random(8);
+    for (const std::size_t to : {2, 6, 9}) {
+        constexpr std::size_t draws = 100'000;
+        std::vector<std::size_t> counts(to + 1);
+        for (std::size_t i = 0; i < draws; ++i) {
+            const std::size_t index = random.get_rand(to);
+            check(index <= to, "get_rand bound");
+            ++counts[index];
+        }
+        check_uniform(counts, draws, "get_rand is uniform");
+
+        std::vector<std::size_t> batch(draws);
+        random.get_rands(to, batch);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (const auto index : batch) {
+            check(index <= to, "get_rands bound");
+            ++counts[index];
+        }
+        check_uniform(counts, draws, "get_rands is uniform");
+    }
+    check(random.get_rand(0) == 0, "get_rand of single index");
+}
+
+// threads enqueueing and dequeueing at once neither lose nor duplicate elements
+void check_concurrent()
+{
+    constexpr int threads = 4;
+    constexpr int per_thread = 5'000;
+    concurrent_randomized_queue<int> queue(threads, 9);
+    std::vector<std::vector<int>> taken(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                queue.enqueue(t * per_thread + i);
+                if (i % 3 != 0) {
+                    if (auto el = queue.try_dequeue()) {
+                        taken[t].push_back(*el);
+                    }
+                }
+            }
+        });
+    }
+    for (auto & worker : workers) {
+        worker.join();
+    }
+    std::vector<int> all;
+    for (const auto & part : taken) {
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    check(queue.size() == threads * per_thread - all.size(), "concurrent size");
+    while (auto el = queue.try_dequeue()) {
+        all.push_back(*el);
+    }
+    check(queue.empty() && is_permutation_of_range(all, threads * per_thread), "concurrent queue keeps every element once");
+}
+
+// count within 5 standard deviations of the binomial expectation
+void check_binomial(std::size_t count, std::size_t draws, double p, const char * what)
+{
+    check(std::abs(count - draws * p) <= 5 * std::sqrt(draws * p * (1 - p)) + 1e-9, what);
+}
+
+// elements are taken in proportion to their weights, which follow their handles through swaps and changes
+void check_weighted()
+{
+    const std::vector<double> weights{1, 2, 3, 4, 0};
+    weighted_randomized_queue<int> queue(10);
+    std::vector<weighted_randomized_queue<int>::handle> handles;
+    for (int i = 0; i < 5; ++i) {
+        handles.push_back(queue.enqueue(i, weights[i]));
+    }
+    check(queue.total_weight() == 10, "total weight");
+
+    constexpr std::size_t draws = 100'000;
+    std::vector<std::size_t> counts(5);
+    for (std::size_t i = 0; i < draws; ++i) {
+        ++counts[queue.sample()];
+    }
+    for (int i = 0; i < 5; ++i) {
+        check_binomial(counts[i], draws, weights[i] / 10, "sample follows weights");
+    }
+
+    queue.set_weight(handles[4], 10);
+    queue.set_weight(handles[0], 0);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (std::size_t i = 0; i < draws; ++i) {
+        ++counts[queue.sample()];
+    }
+    const std::vector<double> changed{0, 2, 3, 4, 10};
+    for (int i = 0; i < 5; ++i) {
+        check_binomial(counts[i], draws, changed[i] / 19, "sample follows changed weights");
+    }
+
+    // first element taken out follows weights as well
+    std::fill(counts.begin(), counts.end(), 0);
+    constexpr std::size_t rounds = 20'000;
+    for (std::size_t round = 0; round < rounds; ++round) {
+        weighted_randomized_queue<int> fresh(round);
+        for (int i = 0; i < 5; ++i) {
+            fresh.enqueue(i, weights[i]);
+        }
+        ++counts[fresh.dequeue()];
+    }
+    for (int i = 0; i < 5; ++i) {
+        check_binomial(counts[i], rounds, weights[i] / 10, "dequeue follows weights");
+    }
+
+    // handles keep naming their elements while others leave, freed ones are reused
+    std::vector<int> taken;
+    while (queue.size() > 2) {
+        taken.push_back(queue.dequeue());
+        for (int i = 0; i < 5; ++i) {
+            if (std::find(taken.begin(), taken.end(), i) == taken.end()) {
+                check(queue.weight(handles[i]) == changed[i], "weight by handle");
+            }
+        }
+    }
+    const auto reused = queue.enqueue(5, 1);
+    check(std::find(handles.begin(), handles.end(), reused) != handles.end(), "handle reused");
+    check(std::abs(queue.total_weight() - (19 - changed[taken[0]] - changed[taken[1]] - changed[taken[2]] + 1)) < 1e-9, "total weight after dequeue");
+
+    bool thrown = false;
+    try {
+        queue.enqueue(6, -1);
+    }
+    catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    check(thrown && queue.size() == 3, "negative weight is rejected");
+
+    // no positive weight: uniform
+    weighted_randomized_queue<int> zero(11);
+    for (int i = 0; i < 4; ++i) {
+        zero.enqueue(i, 0);
+    }
+    std::vector<std::size_t> zero_counts(4);
+    for (std::size_t i = 0; i < draws; ++i) {
+        ++zero_counts[zero.sample()];
+    }
+    check_uniform(zero_counts, draws, "sample of zero weights is uniform");
+}
+
+// a reservoir keeps capacity distinct elements, every element of the stream equally likely
+void check_reservoir()
+{
+    constexpr std::size_t capacity = 10;
+    constexpr int stream = 200;
+    constexpr std::size_t rounds = 20'000;
+    std::vector<std::size_t> counts(stream);
+    for (std::size_t round = 0; round < rounds; ++round) {
+        randomized_queue<int> queue(additionals::reservoir{capacity}, round);
+        for (int i = 0; i < stream; ++i) {
+            queue.enqueue(i);
+        }
+        check(queue.size() == capacity && queue.capacity() == capacity, "reservoir size");
+        std::vector<int> kept(queue.begin(), queue.end());
+        std::sort(kept.begin(), kept.end());
+        check(std::adjacent_find(kept.begin(), kept.end()) == kept.end(), "reservoir keeps distinct elements");
+        for (const int el : kept) {
+            ++counts[el];
+        }
+    }
+    for (const auto count : counts) {
+        check_binomial(count, rounds, static_cast<double>(capacity) / stream, "reservoir keeps elements uniformly");
+    }
+
+    randomized_queue<int> short_stream(additionals::reservoir{capacity}, 12);
+    for (int i = 0; i < 5; ++i) {
+        short_stream.enqueue(i);
+    }
+    check(is_permutation_of_range(std::vector<int>(short_stream.begin(), short_stream.end()), 5), "reservoir keeps a short stream whole");
+
+    randomized_queue<int> single(additionals::reservoir{0}, 13);
+    for (int i = 0; i < 100; ++i) {
+        single.enqueue(i);
+    }
+    check(single.capacity() == 1 && single.size() == 1, "reservoir holds at least one element");
+    single.dequeue();
+    single.enqueue(100);
+    check(single.size() == 1 && single.dequeue() == 100, "dequeue frees a place");
+}
+
+} // anonymous namespace
+
+int main()
+{
+    check_permutation();
+    check_iteration();
+    check_batches();
+    check_replay();
+    check_bounded();
+    check_concurrent();
+    check_weighted();
+    check_reservoir();
+    std::cout << "randomized_queue checks passed" << std::endl;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "randomized_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+// randomized_queue many threads enqueue to and dequeue from at once, split into shards with a lock each:
+// a thread works with its own shard and steals from a random other shard only when its own is empty,
+// so threads meet on one lock only while stealing
+// an element is taken uniformly from the shard it is in, with threads feeding shards evenly the pick is close to uniform overall
+template <class T, class Engine = additionals::xoshiro256starstar>
+class concurrent_randomized_queue
+{
+public:
+    explicit concurrent_randomized_queue(std::size_t shards = std::max(1u, std::thread::hardware_concurrency()),
+                                         std::uint64_t seed = std::random_device{}())
+        : m_shards(std::max<std::size_t>(1, shards))
+    {
+        for (auto & shard : m_shards) {
+            shard.m_queue.seed(additionals::splitmix64(seed));
+        }
+    }
+
+    concurrent_randomized_queue(const concurrent_randomized_queue &) = delete;
+    concurrent_randomized_queue & operator=(const concurrent_randomized_queue &) = delete;
+
+    template <class T1>
+    void enqueue(T1 && el)
+    {
+        Shard & shard = m_shards[m_home()];
+        std::lock_guard lock(shard.m_mutex);
+        shard.m_queue.enqueue(std::forward<T1>(el));
+        shard.m_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // random element of the own shard, of another one when the own is empty, nothing when all of them are
+    std::optional<T> try_dequeue()
+    {
+        const std::size_t home = m_home();
+        if (auto el = m_tryDequeue(m_shards[home], false)) {
+            return el;
+        }
+        // victims in random order: random start, then every shard once, first skipping busy ones, then waiting for them
+        const std::size_t start = m_stealStart();
+        for (const bool wait : {false, true}) {
+            for (std::size_t i = 0; i < m_shards.size(); ++i) {
+                if (auto el = m_tryDequeue(m_shards[(start + i) % m_shards.size()], wait)) {
+                    return el;
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    // exact only while no thread changes the queue
+    std::size_t size() const
+    {
+        std::size_t size = 0;
+        for (const auto & shard : m_shards) {
+            size += shard.m_size.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::mutex m_mutex;
+        randomized_queue<T, Engine> m_queue;
+        std::atomic<std::size_t> m_size = 0; // read without the lock to skip empty shards
+    };
+
+    std::vector<Shard> m_shards;
+
+    // threads get shards in turn as they come, the same in every queue
+    std::size_t m_home() const
+    {
+        static std::atomic<std::size_t> next_ticket = 0;
+        thread_local const std::size_t ticket = next_ticket++;
+        return ticket % m_shards.size();
+    }
+
+    std::size_t m_stealStart() const
+    {
+        thread_local additionals::xoshiro256starstar random(std::random_device{}());
+        return random() % m_shards.size();
+    }
+
+    static std::optional<T> m_tryDequeue(Shard & shard, bool wait)
+    {
+        if (shard.m_size.load(std::memory_order_relaxed) == 0) {
+            return std::nullopt;
+        }
+        std::unique_lock lock(shard.m_mutex, std::defer_lock);
+        if (wait) {
+            lock.lock();
+        }
+        else if (!lock.try_lock()) {
+            return std::nullopt;
+        }
+        if (shard.m_queue.empty()) {
+            return std::nullopt;
+        }
+        shard.m_size.fetch_sub(1, std::memory_order_relaxed);
+        return shard.m_queue.dequeue();
+    }
+};
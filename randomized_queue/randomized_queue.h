@@ -1,31 +1,344 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <limits>
-#include <numeric>
+#include <memory>
 #include <random>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace additionals {
+
+// next output of splitmix64 generator with 'state', spreads one seed over bigger engine states
+inline std::uint64_t splitmix64(std::uint64_t & state)
+{
+    std::uint64_t x = (state += 0x9e3779b97f4a7c15ull);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// 64 x 64 -> 128 bit product as (high, low) halves
+inline std::pair<std::uint64_t, std::uint64_t> multiply_wide(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ using uint128 = unsigned __int128;
+    const uint128 product = static_cast<uint128>(a) * b;
+    return {static_cast<std::uint64_t>(product >> 64), static_cast<std::uint64_t>(product)};
+#else
+    // over 32 bit halves, no partial sum overflows
+    const std::uint64_t a_low = a & 0xffffffffu, a_high = a >> 32;
+    const std::uint64_t b_low = b & 0xffffffffu, b_high = b >> 32;
+    const std::uint64_t low_low = a_low * b_low;
+    const std::uint64_t high_low = a_high * b_low;
+    const std::uint64_t low_high = a_low * b_high;
+    const std::uint64_t middle = (low_low >> 32) + (high_low & 0xffffffffu) + low_high;
+    return {a_high * b_high + (high_low >> 32) + (middle >> 32), middle << 32 | (low_low & 0xffffffffu)};
+#endif
+}
+
+// xoshiro256** by Blackman and Vigna: 256 bits of state, a few shifts and two multiplications per 64 bit output
+class xoshiro256starstar
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit xoshiro256starstar(std::uint64_t seed = 0)
+    {
+        for (auto & word : m_state) {
+            word = splitmix64(seed);
+        }
+    }
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator()()
+    {
+        const std::uint64_t result = std::rotl(m_state[1] * 5, 7) * 9;
+        const std::uint64_t t = m_state[1] << 17;
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = std::rotl(m_state[3], 45);
+        return result;
+    }
+
+private:
+    std::array<std::uint64_t, 4> m_state;
+}; // end of xoshiro256starstar
+
+// four independent xoshiro256** streams stepped together, with AVX2 in one go,
+// without it lane by lane giving the very same numbers (replay does not depend on build flags)
+class xoshiro256starstar_x4
+{
+public:
+    static constexpr std::size_t lanes = 4;
+
+    explicit xoshiro256starstar_x4(std::uint64_t seed = 0)
+    {
+        for (auto & word : m_state) {
+            for (auto & lane_word : word) {
+                lane_word = splitmix64(seed);
+            }
+        }
+    }
+
+    // fills out with next outputs lane after lane, what is left of the last step is dropped
+    void fill(std::span<std::uint64_t> out)
+    {
+        std::size_t i = 0;
+        for (; i + lanes <= out.size(); i += lanes) {
+            m_next(out.data() + i);
+        }
+        if (i < out.size()) {
+            std::array<std::uint64_t, lanes> rest;
+            m_next(rest.data());
+            std::copy_n(rest.begin(), out.size() - i, out.begin() + i);
+        }
+    }
+
+private:
+    alignas(32) std::array<std::array<std::uint64_t, lanes>, 4> m_state; // [word][lane]
+
+    void m_next(std::uint64_t * out)
+    {
+#if defined(__AVX2__)
+        const auto load = [this](int word) { return _mm256_load_si256(reinterpret_cast<const __m256i *>(m_state[word].data())); };
+        const auto rotl = [](__m256i x, int k) { return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k)); };
+        __m256i s0 = load(0), s1 = load(1), s2 = load(2), s3 = load(3);
+        const __m256i times5 = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+        const __m256i rotated = rotl(times5, 7);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_add_epi64(_mm256_slli_epi64(rotated, 3), rotated));
+        const __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = rotl(s3, 45);
+        const auto store = [this](int word, __m256i value) { _mm256_store_si256(reinterpret_cast<__m256i *>(m_state[word].data()), value); };
+        store(0, s0);
+        store(1, s1);
+        store(2, s2);
+        store(3, s3);
+#else
+        auto & [s0, s1, s2, s3] = m_state;
+        for (std::size_t lane = 0; lane < lanes; ++lane) {
+            out[lane] = std::rotl(s1[lane] * 5, 7) * 9;
+            const std::uint64_t t = s1[lane] << 17;
+            s2[lane] ^= s0[lane];
+            s3[lane] ^= s1[lane];
+            s1[lane] ^= s2[lane];
+            s0[lane] ^= s3[lane];
+            s2[lane] ^= t;
+            s3[lane] = std::rotl(s3[lane], 45);
+        }
+#endif
+    }
+}; // end of xoshiro256starstar_x4
+
+// random numbers for the queue, 'Engine' is any uniform random bit generator,
+// seeded explicitly the whole sequence (iteration orders included) replays exactly
+template <class Engine = xoshiro256starstar>
 struct random_struct
 {
     random_struct()
-        : m_rand_engine(std::random_device{}())
+        : random_struct(static_cast<std::uint64_t>(std::random_device{}()) << 32 | std::random_device{}())
     {
     }
-    int get_rand(int to) const
+
+    explicit random_struct(std::uint64_t seed)
+        : m_rand_engine(m_makeEngine(seed))
+        , m_lanes(~seed)
+    {
+    }
+
+    void seed(std::uint64_t seed)
+    {
+        m_rand_engine = m_makeEngine(seed);
+        m_lanes = xoshiro256starstar_x4(~seed);
+    }
+
+    // uniform over [0, to]
+    std::size_t get_rand(std::size_t to) const
+    {
+        return m_bounded(get_key(), to);
+    }
+
+    // every out[i] uniform over [0, to], raw bits come from the four lane generator
+    void get_rands(std::size_t to, std::span<std::size_t> out) const
+    {
+        m_batch(out, [to](std::size_t) { return to; });
+    }
+
+    // out[i] uniform over [0, to - i], indices of a partial Fisher-Yates shuffle
+    void get_shrinking_rands(std::size_t to, std::span<std::size_t> out) const
+    {
+        m_batch(out, [to](std::size_t i) { return to - i; });
+    }
+
+    // 64 random bits, keys a permutation
+    std::uint64_t get_key() const
+    {
+        if constexpr (Engine::min() == 0 && Engine::max() == std::numeric_limits<std::uint64_t>::max()) {
+            return m_rand_engine();
+        }
+        else if constexpr (Engine::min() == 0 && Engine::max() == std::numeric_limits<std::uint32_t>::max()) {
+            return static_cast<std::uint64_t>(m_rand_engine()) << 32 | m_rand_engine();
+        }
+        else {
+            return std::uniform_int_distribution<std::uint64_t>()(m_rand_engine);
+        }
+    }
+
+    // uniform over [0, 1), the top 53 random bits as mantissa
+    double get_real() const
+    {
+        return static_cast<double>(get_key() >> 11) * 0x1.0p-53;
+    }
+
+    mutable Engine m_rand_engine;
+    mutable xoshiro256starstar_x4 m_lanes;
+
+private:
+    static Engine m_makeEngine(std::uint64_t seed)
+    {
+        if constexpr (std::is_constructible_v<Engine, std::seed_seq &>) {
+            std::seed_seq sequence{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+            return Engine(sequence);
+        }
+        else {
+            return Engine(seed);
+        }
+    }
+
+    // Lemire's multiply and shift: high half of bits * (to + 1) is the index, low half tells the rare biased draws
+    // which are taken again, the one division happens only then
+    std::uint64_t m_bounded(std::uint64_t bits, std::uint64_t to) const
     {
-        std::uniform_int_distribution distribution(0, to);
-        return distribution(m_rand_engine);
+        if (to == std::numeric_limits<std::uint64_t>::max()) {
+            return bits;
+        }
+        const std::uint64_t range = to + 1;
+        auto [high, low] = multiply_wide(bits, range);
+        if (low < range) {
+            const std::uint64_t threshold = -range % range;
+            while (low < threshold) {
+                std::tie(high, low) = multiply_wide(get_key(), range);
+            }
+        }
+        return high;
     }
 
-    mutable std::mt19937 m_rand_engine;
+    template <class Bound>
+    void m_batch(std::span<std::size_t> out, Bound bound) const
+    {
+        std::array<std::uint64_t, 64> bits;
+        for (std::size_t done = 0; done < out.size(); done += bits.size()) {
+            const std::size_t count = std::min(bits.size(), out.size() - done);
+            m_lanes.fill({bits.data(), count});
+            for (std::size_t i = 0; i < count; ++i) {
+                out[done + i] = m_bounded(bits[i], bound(done + i));
+            }
+        }
+    }
 }; // end of random_struct
 
+// keyed pseudo random bijection of [0, size) computed one index at a time, nothing is stored but the key:
+// Feistel network over the smallest power of two domain with even bit count that covers size,
+// results outside of [0, size) go through the network again until they land inside (cycle walking, under 4 trips on average)
+class random_permutation
+{
+public:
+    random_permutation() = default;
+
+    random_permutation(std::size_t size, std::uint64_t key)
+        : m_size(size)
+        , m_key(key)
+    {
+        const unsigned bits = size < 2 ? 0 : std::bit_width(size - 1);
+        m_half_bits = (bits + 1) / 2;
+        m_half_mask = (std::uint64_t{1} << m_half_bits) - 1;
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    std::size_t operator()(std::size_t index) const
+    {
+        std::uint64_t value = index;
+        do {
+            value = m_encrypt(value);
+        } while (value >= m_size);
+        return value;
+    }
+
+private:
+    static constexpr int rounds = 8; // four leave the first index several percent off uniform on small domains
+
+    std::size_t m_size = 0;
+    std::uint64_t m_key = 0;
+    unsigned m_half_bits = 0;
+    std::uint64_t m_half_mask = 0;
+
+    std::uint64_t m_encrypt(std::uint64_t value) const
+    {
+        std::uint64_t left = value >> m_half_bits;
+        std::uint64_t right = value & m_half_mask;
+        for (int round = 0; round < rounds; ++round) {
+            const std::uint64_t next = left ^ m_round(right, round);
+            left = right;
+            right = next;
+        }
+        return left << m_half_bits | right;
+    }
+
+    // splitmix64 finalizer of half mixed with key and round
+    std::uint64_t m_round(std::uint64_t half, int round) const
+    {
+        std::uint64_t x = half ^ (m_key + (round + 1) * 0x9e3779b97f4a7c15ull);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return (x ^ (x >> 31)) & m_half_mask;
+    }
+}; // end of random_permutation
+
+// capacity of a randomized_queue that keeps a uniform sample of everything enqueued instead of all of it
+struct reservoir
+{
+    std::size_t capacity;
+};
+
 } // namespace additionals
 
-template <class T>
+template <class T, class Engine = additionals::xoshiro256starstar, class Allocator = std::allocator<T>>
 class randomized_queue
 {
 private:
@@ -37,15 +350,20 @@ private:
     private:
         using rand_queue = std::conditional_t<is_const, const randomized_queue, randomized_queue>;
 
+        // every iterator made this way walks its own order, copies of it walk the same
         Iterator(rand_queue * _queue, std::size_t _pos)
             : m_position(_pos)
-            , m_map_numbers(_queue->size())
+            , m_permutation(_queue->size(), _queue->m_random.get_key())
             , m_data(&_queue->m_data)
         {
-            std::iota(m_map_numbers.begin(), m_map_numbers.end(), 0);
-            std::shuffle(m_map_numbers.begin(), m_map_numbers.end(), _queue->m_random.m_rand_engine);
-            m_map_numbers.push_back(npos);
-        };
+        }
+
+        // past the end, needs no order
+        Iterator(rand_queue * _queue, std::size_t _pos, std::nullptr_t)
+            : m_position(_pos)
+            , m_data(&_queue->m_data)
+        {
+        }
 
         Iterator(rand_queue * _queue)
             : Iterator(_queue, 0){};
@@ -60,9 +378,9 @@ private:
         Iterator() = default;
         ~Iterator() = default;
 
-        reference operator*() const { return (*m_data)[m_map_numbers[m_position]]; }
+        reference operator*() const { return (*m_data)[m_permutation(m_position)]; }
 
-        pointer operator->() { return m_data[m_map_numbers[m_position]]; }
+        pointer operator->() const { return &**this; }
 
         Iterator & operator++()
         {
@@ -89,11 +407,9 @@ private:
         }
 
     private:
-        static constexpr std::size_t npos = std::numeric_limits<unsigned long long>::max();
-
         std::size_t m_position;
-        std::vector<std::size_t> m_map_numbers;
-        using type = std::conditional_t<is_const, const std::vector<T>, std::vector<T>>;
+        additionals::random_permutation m_permutation;
+        using type = std::conditional_t<is_const, const std::vector<T, Allocator>, std::vector<T, Allocator>>;
         type * m_data;
 
         static bool equal_data(const Iterator & a, const Iterator & b)
@@ -105,8 +421,34 @@ private:
     using iterator = Iterator<false>;
     using const_iterator = Iterator<true>;
 
-    std::vector<T> m_data;
-    additionals::random_struct m_random;
+    std::vector<T, Allocator> m_data;
+    additionals::random_struct<Engine> m_random;
+
+    // reservoir mode (Algorithm L): once full, only every m_next-th enqueued element since then replaces a random one,
+    // the gaps are geometric, so elements in between cost no random numbers at all
+    std::size_t m_capacity = 0; // 0 is no limit
+    std::size_t m_seen = 0;
+    std::size_t m_next = 0;
+    double m_w = 0;
+
+    // random number in (0, 1], has a logarithm
+    double m_openReal() const
+    {
+        return 1 - m_random.get_real();
+    }
+
+    void m_skip()
+    {
+        const double gap = std::floor(std::log(m_openReal()) / std::log1p(-m_w));
+        m_next = m_seen + 1 + static_cast<std::size_t>(std::min(gap, 0x1.0p62));
+    }
+
+    void m_startReservoir()
+    {
+        m_seen = m_capacity;
+        m_w = std::exp(std::log(m_openReal()) / m_capacity);
+        m_skip();
+    }
 
 public:
     iterator begin()
@@ -116,7 +458,7 @@ public:
 
     iterator end()
     {
-        return {this, size()};
+        return {this, size(), nullptr};
     }
 
     iterator back()
@@ -131,7 +473,7 @@ public:
 
     const_iterator cend() const
     {
-        return {this, size()};
+        return {this, size(), nullptr};
     }
 
     iterator cback()
@@ -151,8 +493,56 @@ public:
     {
     }
 
+    // elements (and scratch of sample_n) live in memory of allocator
+    explicit randomized_queue(const Allocator & allocator)
+        : m_data(allocator)
+        , m_random()
+    {
+    }
+
+    // same seed, same calls: same elements come out in the same order
+    explicit randomized_queue(std::uint64_t seed, const Allocator & allocator = Allocator())
+        : m_data(allocator)
+        , m_random(seed)
+    {
+    }
+
+    // holds at most capacity elements: a uniform sample of everything enqueued since it was last full,
+    // memory stays the same however many elements come, dequeue() frees places for the next ones
+    explicit randomized_queue(additionals::reservoir mode, const Allocator & allocator = Allocator())
+        : m_data(allocator)
+        , m_random()
+        , m_capacity(std::max<std::size_t>(1, mode.capacity))
+    {
+        m_data.reserve(m_capacity);
+    }
+
+    randomized_queue(additionals::reservoir mode, std::uint64_t seed, const Allocator & allocator = Allocator())
+        : m_data(allocator)
+        , m_random(seed)
+        , m_capacity(std::max<std::size_t>(1, mode.capacity))
+    {
+        m_data.reserve(m_capacity);
+    }
+
+    Allocator get_allocator() const
+    {
+        return m_data.get_allocator();
+    }
+
+    void seed(std::uint64_t seed)
+    {
+        m_random.seed(seed);
+    }
+
     ~randomized_queue() = default;
 
+    // 0 if not a reservoir
+    std::size_t capacity() const
+    {
+        return m_capacity;
+    }
+
     bool empty() const
     {
         return m_data.empty();
@@ -166,7 +556,19 @@ public:
     template <class T1>
     void enqueue(T1 && el)
     {
-        m_data.push_back(std::forward<T1>(el));
+        if (m_capacity == 0 || m_data.size() < m_capacity) {
+            m_data.push_back(std::forward<T1>(el));
+            if (m_data.size() == m_capacity) {
+                m_startReservoir();
+            }
+            return;
+        }
+        if (++m_seen < m_next) {
+            return;
+        }
+        m_data[m_random.get_rand(m_capacity - 1)] = std::forward<T1>(el);
+        m_w *= std::exp(std::log(m_openReal()) / m_capacity);
+        m_skip();
     }
 
     T dequeue()
@@ -183,4 +585,78 @@ public:
     {
         return (m_data[m_random.get_rand(m_data.size() - 1)]);
     }
+
+    // moves min(k, size()) random elements to out in the order that many dequeue() calls would give them,
+    // partial Fisher-Yates gathers them at the end of m_data, indices are drawn in batches
+    template <class OutputIt>
+    OutputIt dequeue_n(std::size_t k, OutputIt out)
+    {
+        k = std::min(k, m_data.size());
+        const std::size_t stop = m_data.size() - k;
+        std::array<std::size_t, batch_size> indices;
+        for (std::size_t last = m_data.size(); last > stop;) {
+            const std::span<std::size_t> batch(indices.data(), std::min(batch_size, last - stop));
+            m_random.get_shrinking_rands(last - 1, batch);
+            for (const std::size_t index : batch) {
+                --last;
+                using std::swap;
+                swap(m_data[index], m_data[last]);
+            }
+        }
+        out = std::move(m_data.rbegin(), m_data.rbegin() + k, out);
+        m_data.erase(m_data.begin() + stop, m_data.end());
+        return out;
+    }
+
+    enum class sampling
+    {
+        with_replacement,    // k elements, any of them may repeat
+        without_replacement, // min(k, size()) distinct elements
+    };
+
+    // copies random elements to out, the queue is left as it is
+    // without replacement it is a partial Fisher-Yates shuffle over indices that keeps only the displaced ones
+    template <class OutputIt>
+    OutputIt sample_n(std::size_t k, OutputIt out, sampling mode = sampling::without_replacement) const
+    {
+        if (m_data.empty()) {
+            return out;
+        }
+        if (mode == sampling::without_replacement) {
+            k = std::min(k, m_data.size());
+        }
+        using displaced_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const std::size_t, std::size_t>>;
+        std::unordered_map<std::size_t, std::size_t, std::hash<std::size_t>, std::equal_to<std::size_t>, displaced_allocator>
+                displaced(0, std::hash<std::size_t>(), std::equal_to<std::size_t>(), displaced_allocator(get_allocator())); // position -> index moved there by a swap
+        if (mode == sampling::without_replacement) {
+            displaced.reserve(k);
+        }
+        const auto at = [&displaced](std::size_t position) {
+            const auto it = displaced.find(position);
+            return it == displaced.end() ? position : it->second;
+        };
+        std::array<std::size_t, batch_size> indices;
+        for (std::size_t done = 0; done < k;) {
+            const std::span<std::size_t> batch(indices.data(), std::min(batch_size, k - done));
+            if (mode == sampling::with_replacement) {
+                m_random.get_rands(m_data.size() - 1, batch);
+                for (const std::size_t index : batch) {
+                    *out++ = m_data[index];
+                }
+            }
+            else {
+                std::size_t last = m_data.size() - 1 - done;
+                m_random.get_shrinking_rands(last, batch);
+                for (const std::size_t position : batch) {
+                    *out++ = m_data[at(position)];
+                    displaced[position] = at(last--);
+                }
+            }
+            done += batch.size();
+        }
+        return out;
+    }
+
+private:
+    static constexpr std::size_t batch_size = 64;
 };
\ No newline at end of file
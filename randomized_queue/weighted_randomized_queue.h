@@ -0,0 +1,188 @@
+#pragma once
+
+#include "randomized_queue.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// randomized_queue taking elements with probability proportional to their weights,
+// a Fenwick tree over the weights finds the element a random point of the total weight falls on in O(log n),
+// so enqueue, dequeue, sample and weight changes are all O(log n)
+// weight 0 elements are never taken while some weight is positive, if none is the pick is uniform
+template <class T, class Engine = additionals::xoshiro256starstar>
+class weighted_randomized_queue
+{
+public:
+    // names an element for weight changes as long as it is in the queue, then may be given to a new one
+    using handle = std::size_t;
+
+    weighted_randomized_queue() = default;
+
+    explicit weighted_randomized_queue(std::uint64_t seed)
+        : m_random(seed)
+    {
+    }
+
+    void seed(std::uint64_t seed)
+    {
+        m_random.seed(seed);
+    }
+
+    bool empty() const
+    {
+        return m_data.empty();
+    }
+
+    std::size_t size() const
+    {
+        return m_data.size();
+    }
+
+    double total_weight() const
+    {
+        return m_prefix(m_data.size());
+    }
+
+    template <class T1>
+    handle enqueue(T1 && el, double weight)
+    {
+        m_checkWeight(weight);
+        handle h;
+        if (m_freeHandles.empty()) {
+            h = m_positions.size();
+            m_positions.push_back(m_data.size());
+        }
+        else {
+            h = m_freeHandles.back();
+            m_freeHandles.pop_back();
+            m_positions[h] = m_data.size();
+        }
+        m_data.push_back(std::forward<T1>(el));
+        m_weights.push_back(weight);
+        m_handles.push_back(h);
+        m_pushTree(weight);
+        return h;
+    }
+
+    T dequeue()
+    {
+        const std::size_t position = m_pick();
+        T element_to_return = std::move(m_data[position]);
+        m_freeHandles.push_back(m_handles[position]);
+
+        // last element takes the place of the taken one
+        const std::size_t last = m_data.size() - 1;
+        m_add(position, m_weights[last] - m_weights[position]);
+        m_data[position] = std::move(m_data[last]);
+        m_weights[position] = m_weights[last];
+        m_handles[position] = m_handles[last];
+        m_positions[m_handles[position]] = position;
+        m_data.pop_back();
+        m_weights.pop_back();
+        m_handles.pop_back();
+        m_tree.pop_back(); // no other node of the tree counts the last element
+        m_countChange();
+        return element_to_return;
+    }
+
+    const T & sample() const
+    {
+        return m_data[m_pick()];
+    }
+
+    double weight(handle h) const
+    {
+        return m_weights[m_positions[h]];
+    }
+
+    void set_weight(handle h, double weight)
+    {
+        m_checkWeight(weight);
+        const std::size_t position = m_positions[h];
+        m_add(position, weight - m_weights[position]);
+        m_weights[position] = weight;
+        m_countChange();
+    }
+
+private:
+    std::vector<T> m_data;
+    std::vector<double> m_weights;
+    std::vector<double> m_tree{0.0};      // Fenwick tree: node i (from 1) sums weights of elements (i - lowest bit of i, i]
+    std::vector<handle> m_handles;        // of element at position
+    std::vector<std::size_t> m_positions; // of element with handle
+    std::vector<handle> m_freeHandles;
+    std::size_t m_changes = 0; // rounding errors gathered in the tree since it was summed up anew
+    additionals::random_struct<Engine> m_random;
+
+    static void m_checkWeight(double weight)
+    {
+        if (!std::isfinite(weight) || weight < 0) {
+            throw std::invalid_argument("weight has to be finite and not negative");
+        }
+    }
+
+    // sum of weights of the first count elements
+    double m_prefix(std::size_t count) const
+    {
+        double sum = 0;
+        for (; count > 0; count &= count - 1) {
+            sum += m_tree[count];
+        }
+        return sum;
+    }
+
+    void m_add(std::size_t position, double delta)
+    {
+        for (std::size_t i = position + 1; i < m_tree.size(); i += i & -i) {
+            m_tree[i] += delta;
+        }
+    }
+
+    // node for a new last element: its weight and those of elements before it the node covers
+    void m_pushTree(double weight)
+    {
+        const std::size_t i = m_tree.size();
+        m_tree.push_back(weight + m_prefix(i - 1) - m_prefix(i - (i & -i)));
+    }
+
+    // position of element a uniform point of the total weight falls on
+    std::size_t m_pick() const
+    {
+        const std::size_t count = m_data.size();
+        const double total = total_weight();
+        if (!(total > 0)) {
+            return m_random.get_rand(count - 1);
+        }
+        double point = m_random.get_real() * total;
+        std::size_t position = 0;
+        for (std::size_t step = std::bit_floor(count); step > 0; step >>= 1) {
+            if (position + step <= count && m_tree[position + step] <= point) {
+                position += step;
+                point -= m_tree[position];
+            }
+        }
+        return std::min(position, count - 1); // rounding may run past the last element
+    }
+
+    // once changes outnumber elements the tree is summed up again in O(n), that keeps rounding errors small
+    void m_countChange()
+    {
+        if (++m_changes <= m_data.size()) {
+            return;
+        }
+        m_changes = 0;
+        for (std::size_t i = 1; i < m_tree.size(); ++i) {
+            m_tree[i] = m_weights[i - 1];
+        }
+        for (std::size_t i = 1; i < m_tree.size(); ++i) {
+            const std::size_t parent = i + (i & -i);
+            if (parent < m_tree.size()) {
+                m_tree[parent] += m_tree[i];
+            }
+        }
+    }
+};
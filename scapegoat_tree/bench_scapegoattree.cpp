@@ -0,0 +1,175 @@
+#include "scapegoattree.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class Stream
+{
+    Sequential,
+    Random,
+    Zipfian,    // skewed: few keys take most of the stream
+    Adversarial // converging from both ends, every key lands at the bottom of one long zigzag path
+};
+
+const char * stream_name(Stream stream)
+{
+    switch (stream) {
+    case Stream::Sequential:
+        return "sequential";
+    case Stream::Random:
+        return "random";
+    case Stream::Zipfian:
+        return "zipfian";
+    case Stream::Adversarial:
+        return "adversarial";
+    }
+    return "";
+}
+
+// zipf distribution with exponent 0.99 over 'count' ranks, ranks are scattered over the key space
+std::vector<std::uint64_t> zipfian_keys(std::size_t count, std::mt19937_64 & random)
+{
+    std::vector<double> cdf(count);
+    double sum = 0;
+    for (std::size_t rank = 0; rank < count; ++rank) {
+        sum += 1 / std::pow(rank + 1, 0.99);
+        cdf[rank] = sum;
+    }
+    std::uniform_real_distribution<double> uniform(0, sum);
+    std::vector<std::uint64_t> keys(count);
+    for (auto & key : keys) {
+        const std::uint64_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(random)) - cdf.begin();
+        key = rank * 0x9e3779b97f4a7c15ull; // odd multiplier is a bijection, hot keys do not cluster
+    }
+    return keys;
+}
+
+std::vector<std::uint64_t> make_keys(Stream stream, std::size_t count)
+{
+    std::mt19937_64 random(42);
+    std::vector<std::uint64_t> keys(count);
+    switch (stream) {
+    case Stream::Sequential:
+        std::iota(keys.begin(), keys.end(), 0);
+        break;
+    case Stream::Random:
+        std::iota(keys.begin(), keys.end(), 0);
+        std::shuffle(keys.begin(), keys.end(), random);
+        break;
+    case Stream::Zipfian:
+        keys = zipfian_keys(count, random);
+        break;
+    case Stream::Adversarial:
+        for (std::size_t i = 0; i < count; ++i) {
+            keys[i] = i % 2 == 0 ? i / 2 : count - 1 - i / 2;
+        }
+        break;
+    }
+    return keys;
+}
+
+struct Params
+{
+    Stream m_stream;
+    double m_alpha;
+    std::vector<std::uint64_t> m_keys;
+
+    explicit Params(const benchmark::State & state)
+        : m_stream(static_cast<Stream>(state.range(0)))
+        , m_alpha(state.range(1) / 100.0)
+        , m_keys(make_keys(m_stream, state.range(2)))
+    {
+    }
+};
+
+void report(benchmark::State & state, const ScapegoatTree<std::uint64_t> & tree, std::size_t ops)
+{
+    const auto stats = tree.rebuild_stats();
+    state.SetLabel(stream_name(static_cast<Stream>(state.range(0))));
+    state.counters["time/op"] = benchmark::Counter(static_cast<double>(ops), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["rebuilds"] = static_cast<double>(stats.rebuilds);
+    state.counters["rebuilt_nodes"] = static_cast<double>(stats.rebuilt_nodes);
+    state.counters["height"] = static_cast<double>(tree.height());
+}
+
+// whole stream inserted into an empty tree per iteration
+void BM_Insert(benchmark::State & state)
+{
+    const Params params(state);
+    ScapegoatTree<std::uint64_t> tree(params.m_alpha);
+    std::size_t ops = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        tree = ScapegoatTree<std::uint64_t>(params.m_alpha);
+        state.ResumeTiming();
+        for (const auto key : params.m_keys) {
+            tree.insert(key);
+        }
+        ops += params.m_keys.size();
+    }
+    report(state, tree, ops);
+}
+
+// whole stream removed from a tree holding it per iteration
+void BM_Remove(benchmark::State & state)
+{
+    const Params params(state);
+    ScapegoatTree<std::uint64_t> tree(params.m_alpha);
+    std::size_t ops = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        tree = ScapegoatTree<std::uint64_t>(params.m_alpha);
+        for (const auto key : params.m_keys) {
+            tree.insert(key);
+        }
+        state.ResumeTiming();
+        for (const auto key : params.m_keys) {
+            tree.remove(key);
+        }
+        ops += params.m_keys.size();
+    }
+    report(state, tree, ops);
+}
+
+// one key of the stream looked up per iteration, in a tree built by inserting the stream
+void BM_Contains(benchmark::State & state)
+{
+    const Params params(state);
+    ScapegoatTree<std::uint64_t> tree(params.m_alpha);
+    for (const auto key : params.m_keys) {
+        tree.insert(key);
+    }
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.contains(params.m_keys[i]));
+        i = i + 1 == params.m_keys.size() ? 0 : i + 1;
+    }
+    report(state, tree, state.iterations());
+}
+
+// streams x alpha in percent over the accepted [0.5, 1) x number of keys
+void arguments(benchmark::internal::Benchmark * benchmark)
+{
+    benchmark->ArgNames({"stream", "alpha%", "keys"});
+    benchmark->ArgsProduct({{static_cast<int>(Stream::Sequential), static_cast<int>(Stream::Random), static_cast<int>(Stream::Zipfian), static_cast<int>(Stream::Adversarial)},
+                            {50, 60, 75, 90, 99},
+                            {1 << 16}});
+    benchmark->Unit(benchmark::kMillisecond);
+}
+
+} // anonymous namespace
+
+BENCHMARK(BM_Insert)->Apply(arguments);
+BENCHMARK(BM_Remove)->Apply(arguments);
+BENCHMARK(BM_Contains)->Apply(arguments)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,264 @@
+#include "concurrent_tree.h"
+#include "scapegoattree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// nanoseconds per operation of 'ops' operations made by 'run'
+template <class Run>
+double measure(Run && run, std::size_t ops)
+{
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+// keeps the optimizer from dropping lookups
+volatile std::size_t sink;
+
+template <class Set>
+void set_workload(const std::string & name, const std::vector<std::uint64_t> & keys, const std::vector<std::uint64_t> & lookups)
+{
+    Set set;
+    const double insert_ns = measure([&]() {
+        for (const auto key : keys) {
+            set.insert(key);
+        }
+    },
+                                     keys.size());
+
+    const double find_ns = measure([&]() {
+        std::size_t found = 0;
+        for (const auto key : lookups) {
+            found += set.find(key) != set.end();
+        }
+        sink = found;
+    },
+                                   lookups.size());
+
+    const double iterate_ns = measure([&]() {
+        std::uint64_t sum = 0;
+        for (const auto key : set) {
+            sum += key;
+        }
+        sink = sum;
+    },
+                                      set.size());
+
+    std::cout << name << ": insert " << insert_ns << " ns, find " << find_ns << " ns, iterate " << iterate_ns << " ns" << std::endl;
+}
+
+template <class Map>
+void map_workload(const std::string & name, const std::vector<std::uint64_t> & keys, const std::vector<std::uint64_t> & lookups)
+{
+    Map map;
+    const double emplace_ns = measure([&]() {
+        for (const auto key : keys) {
+            map.emplace(key, key);
+        }
+    },
+                                      keys.size());
+
+    const double find_ns = measure([&]() {
+        std::uint64_t sum = 0;
+        for (const auto key : lookups) {
+            const auto it = map.find(key);
+            if (it != map.end()) {
+                sum += it->second;
+            }
+        }
+        sink = sum;
+    },
+                                   lookups.size());
+
+    const double erase_ns = measure([&]() {
+        for (const auto key : lookups) {
+            map.erase(key);
+        }
+    },
+                                    lookups.size());
+
+    std::cout << name << ": emplace " << emplace_ns << " ns, find " << find_ns << " ns, erase " << erase_ns << " ns" << std::endl;
+}
+
+// whole batch at once against one insert per key
+void bulk_workload(const std::vector<std::uint64_t> & keys)
+{
+    const double one_by_one_ns = measure([&]() {
+        ScapegoatTree<std::uint64_t> tree;
+        for (const auto key : keys) {
+            tree.insert(key);
+        }
+        sink = tree.size();
+    },
+                                         keys.size());
+
+    const double bulk_ns = measure([&]() {
+        ScapegoatTree<std::uint64_t> tree(keys.begin(), keys.end());
+        sink = tree.size();
+    },
+                                   keys.size());
+
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const double parallel_ns = measure([&]() {
+        ScapegoatTree<std::uint64_t> tree;
+        tree.insert_bulk(keys, threads);
+        sink = tree.size();
+    },
+                                       keys.size());
+
+    std::cout << "load: insert " << one_by_one_ns << " ns, insert_bulk " << bulk_ns << " ns, insert_bulk on " << threads << " threads " << parallel_ns << " ns" << std::endl;
+}
+
+// latency of every single insert, rebuilds show up in the tail, and of contains hitting and missing
+void latency_workload(const std::vector<std::uint64_t> & keys, const std::vector<std::uint64_t> & lookups)
+{
+    ScapegoatTree<std::uint64_t> tree;
+    std::vector<double> latencies;
+    latencies.reserve(keys.size());
+    for (const auto key : keys) {
+        latencies.push_back(measure([&]() { tree.insert(key); }, 1));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double p) { return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))]; };
+
+    const double hit_ns = measure([&]() {
+        std::size_t found = 0;
+        for (const auto key : lookups) {
+            found += tree.contains(key);
+        }
+        sink = found;
+    },
+                                  lookups.size());
+
+    const double miss_ns = measure([&]() {
+        std::size_t found = 0;
+        for (const auto key : lookups) {
+            found += tree.contains(key + lookups.size());
+        }
+        sink = found;
+    },
+                                   lookups.size());
+
+    std::cout << "insert latency: p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99) << " ns, p99.9 " << percentile(0.999)
+              << " ns, max " << latencies.back() << " ns; contains hit " << hit_ns << " ns, miss " << miss_ns << " ns" << std::endl;
+}
+
+// lookups in the tree against its frozen copy and binary search over a sorted vector
+void frozen_workload(const std::vector<std::uint64_t> & keys, const std::vector<std::uint64_t> & lookups)
+{
+    const ScapegoatTree<std::uint64_t> tree(keys.begin(), keys.end());
+    const auto frozen = tree.freeze();
+    const auto sorted = tree.values();
+
+    const auto lookup_ns = [&](auto && contains) {
+        return measure([&]() {
+            std::size_t found = 0;
+            for (const auto key : lookups) {
+                found += contains(key);
+            }
+            sink = found;
+        },
+                       lookups.size());
+    };
+
+    const double tree_ns = lookup_ns([&](std::uint64_t key) { return tree.contains(key); });
+    const double frozen_ns = lookup_ns([&](std::uint64_t key) { return frozen.contains(key); });
+    const double sorted_ns = lookup_ns([&](std::uint64_t key) { return std::binary_search(sorted.begin(), sorted.end(), key); });
+
+    std::cout << "contains: tree " << tree_ns << " ns, frozen " << frozen_ns << " ns, sorted vector " << sorted_ns << " ns" << std::endl;
+}
+
+// throughput of 'readers' threads calling contains while one writer keeps inserting and erasing
+void concurrent_workload(const std::vector<std::uint64_t> & keys, std::size_t readers)
+{
+    ConcurrentTree<ScapegoatTree<std::uint64_t>> tree;
+    tree.write([&](auto & copy) { copy.insert_bulk(keys); });
+
+    std::atomic<bool> stop = false;
+    std::atomic<std::size_t> reads = 0;
+    std::atomic<std::size_t> found_total = 0; // sink is written by the calling thread only
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < readers; ++i) {
+        threads.emplace_back([&, i]() {
+            std::mt19937_64 random(i);
+            std::size_t count = 0;
+            std::size_t found = 0;
+            for (; !stop.load(std::memory_order_relaxed); ++count) {
+                found += tree.contains(random() % keys.size());
+            }
+            found_total += found;
+            reads += count;
+        });
+    }
+
+    std::mt19937_64 random(readers);
+    std::size_t writes = 0;
+    const auto duration = std::chrono::milliseconds(500);
+    const auto start = std::chrono::steady_clock::now();
+    for (; std::chrono::steady_clock::now() - start < duration; ++writes) {
+        const std::uint64_t key = keys.size() + random() % keys.size();
+        if (writes % 2 == 0) {
+            tree.insert(key);
+        }
+        else {
+            tree.erase(key);
+        }
+    }
+    stop = true;
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    sink = found_total;
+
+    const double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << "concurrent, " << readers << " readers: " << reads / seconds / 1e6 << " M reads/s, "
+              << writes / seconds / 1e3 << " K writes/s" << std::endl;
+}
+
+void compare(const std::string & workload, const std::vector<std::uint64_t> & keys, const std::vector<std::uint64_t> & lookups)
+{
+    std::cout << "-- " << workload << ", " << keys.size() << " keys" << std::endl;
+    set_workload<ScapegoatTree<std::uint64_t>>("ScapegoatTree", keys, lookups);
+    set_workload<std::set<std::uint64_t>>("std::set", keys, lookups);
+    map_workload<ScapegoatMap<std::uint64_t, std::uint64_t>>("ScapegoatMap", keys, lookups);
+    map_workload<std::map<std::uint64_t, std::uint64_t>>("std::map", keys, lookups);
+    bulk_workload(keys);
+    latency_workload(keys, lookups);
+}
+
+} // anonymous namespace
+
+// usage: benchmark [number of keys], run it with 1'000'000 up to 100'000'000
+int main(int argc, char ** argv)
+{
+    const std::size_t count = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+    std::mt19937_64 random(42);
+
+    std::vector<std::uint64_t> keys(count);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::vector<std::uint64_t> lookups = keys;
+    std::shuffle(lookups.begin(), lookups.end(), random);
+    compare("sequential", keys, lookups);
+    frozen_workload(keys, lookups);
+
+    std::shuffle(keys.begin(), keys.end(), random);
+    compare("random", keys, lookups);
+
+    for (const std::size_t readers : {1, 2, 4, 8, 16}) {
+        concurrent_workload(keys, readers);
+    }
+}
@@ -0,0 +1,237 @@
+#include "concurrent_tree.h"
+#include "scapegoattree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// checks of ScapegoatMap against std::map and of ConcurrentTree under readers, any failure aborts
+
+namespace {
+
+using Map = ScapegoatMap<std::uint32_t, std::string>;
+using Reference = std::map<std::uint32_t, std::string>;
+
+void check(bool condition, const char * what)
+{
+    if (!condition) {
+        std::cerr << "check failed: " << what << std::endl;
+        std::abort();
+    }
+}
+
+template <class F>
+void check_out_of_range(F && f, const char * what)
+{
+    try {
+        f();
+    }
+    catch (const std::out_of_range &) {
+        return;
+    }
+    check(false, what);
+}
+
+void check_equal(const Map & map, const Reference & reference, const char * what)
+{
+    check(map.size() == reference.size() && std::equal(map.begin(), map.end(), reference.begin(), reference.end()), what);
+}
+
+// values long enough to live on the heap, so that rebuilds would show if they lost or copied them wrong
+std::string make_value(std::uint32_t key, unsigned version)
+{
+    return std::string(20, 'v') + std::to_string(key) + '.' + std::to_string(version);
+}
+
+// set operations by key, of equal keys the pair of 'a' stays
+Reference combine(const Reference & a, const Reference & b, unsigned operation)
+{
+    Reference result;
+    const auto out = std::inserter(result, result.end());
+    const auto less = a.value_comp();
+    switch (operation % 3) {
+    case 0:
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), out, less);
+        break;
+    case 1:
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), out, less);
+        break;
+    default:
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), out, less);
+        break;
+    }
+    return result;
+}
+
+Map combine(const Map & a, const Map & b, unsigned operation)
+{
+    switch (operation % 3) {
+    case 0:
+        return merge_union(a, b, 2);
+    case 1:
+        return intersection(a, b, 2);
+    default:
+        return difference(a, b, 2);
+    }
+}
+
+// random operations of every kind, with the element access of a map: operator[], at, try_emplace and mapped values
+void check_operations()
+{
+    constexpr std::uint32_t key_range = 1000;
+    Map map;
+    Reference reference;
+    std::mt19937 random(1);
+    for (unsigned i = 0; i < 20'000; ++i) {
+        const std::uint32_t key = random() % key_range;
+        switch (random() % 10) {
+        case 0:
+        case 1:
+            map[key] = reference[key] = make_value(key, i);
+            break;
+        case 2:
+            check(map.try_emplace(key, make_value(key, i)).second == reference.try_emplace(key, make_value(key, i)).second, "try_emplace");
+            break;
+        case 3:
+            check(map.insert({key, make_value(key, i)}).second == reference.insert({key, make_value(key, i)}).second, "insert");
+            break;
+        case 4:
+        case 5:
+            check(map.erase(key) == reference.erase(key), "erase");
+            break;
+        case 6:
+            if (reference.contains(key)) {
+                map.at(key) += "!";
+                reference.at(key) += "!";
+                check(std::as_const(map).at(key) == reference.at(key), "at");
+            }
+            else {
+                check_out_of_range([&] { map.at(key); }, "at of absent key");
+                check_out_of_range([&] { std::as_const(map).at(key); }, "const at of absent key");
+            }
+            break;
+        case 7: {
+            std::vector<std::pair<std::uint32_t, std::string>> batch;
+            for (unsigned j = random() % 50; j > 0; --j) {
+                const std::uint32_t batch_key = random() % key_range;
+                batch.emplace_back(batch_key, make_value(batch_key, i));
+            }
+            map.insert_bulk(batch, 1 + i % 3);
+            reference.insert(batch.begin(), batch.end());
+            break;
+        }
+        case 8: {
+            Map greater = map.split(key);
+            check(greater.empty() || greater.begin()->first >= key, "split");
+            check(map.size() + greater.size() == reference.size(), "split sizes");
+            map.join(std::move(greater));
+            break;
+        }
+        default: {
+            Map other;
+            Reference other_reference;
+            for (unsigned j = random() % 100; j > 0; --j) {
+                const std::uint32_t other_key = random() % key_range;
+                other[other_key] = other_reference[other_key] = make_value(other_key, i);
+            }
+            map = combine(map, other, i);
+            reference = combine(reference, other_reference, i);
+            break;
+        }
+        }
+        const auto found = map.find(key);
+        const auto expected = reference.find(key);
+        check((found == map.end()) == (expected == reference.end()), "find");
+        check(found == map.end() || found->second == expected->second, "mapped value");
+    }
+    check_equal(map, reference, "map after random operations");
+
+    const Map copy = map;
+    check_equal(copy, reference, "copy");
+    const auto frozen = map.freeze();
+    for (std::uint32_t key = 0; key < key_range; ++key) {
+        const auto * lower = frozen.lower_bound(key);
+        const auto expected = reference.lower_bound(key);
+        check((lower == nullptr) == (expected == reference.end()) && (lower == nullptr || *lower == *expected), "frozen map");
+    }
+}
+
+// mapped values stay where they are while rebuilds relink their nodes
+void check_references()
+{
+    Map map;
+    std::string & first = map[0];
+    first = make_value(0, 0);
+    for (std::uint32_t key = 1; key < 10'000; ++key) {
+        map[key] = make_value(key, 0);
+    }
+    for (std::uint32_t key = 1; key < 10'000; key += 2) {
+        map.erase(key);
+    }
+    check(map.rebuild_stats().rebuilds > 0, "rebuilds happened");
+    check(&map.at(0) == &first && first == make_value(0, 0), "reference after rebuilds");
+    for (std::uint32_t key = 0; key < 10'000; key += 2) {
+        check(map.at(key) == make_value(key, 0), "values after rebuilds");
+    }
+}
+
+// pairs of keys go in and out in one write() each, readers never see half of a pair
+void check_concurrent()
+{
+    using Tree = ScapegoatTree<std::uint32_t>;
+    constexpr std::uint32_t pairs = 4000;
+    constexpr std::uint32_t window = 64; // pairs kept in the tree, older ones are erased
+    ConcurrentTree<Tree> tree;
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 2; ++i) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                const bool whole = tree.read([](const Tree & copy) {
+                    return copy.size() % 2 == 0 && std::all_of(copy.begin(), copy.end(), [&copy](std::uint32_t key) { return copy.contains(key ^ 1); });
+                });
+                check(whole, "pair seen in part");
+                std::this_thread::yield(); // the writer waits for readers to leave, on few cores they would starve it
+            }
+        });
+    }
+    for (std::uint32_t i = 0; i < pairs; ++i) {
+        tree.write([i](Tree & copy) {
+            copy.insert(2 * i);
+            copy.insert(2 * i + 1);
+        });
+        if (i >= window) {
+            const std::uint32_t old = i - window;
+            const bool erased = tree.write([old](Tree & copy) { return copy.erase(2 * old) + copy.erase(2 * old + 1) == 2; });
+            check(erased, "erase of a pair");
+        }
+    }
+    done = true;
+    for (auto & reader : readers) {
+        reader.join();
+    }
+    check(tree.size() == 2 * window, "pairs left");
+    for (std::uint32_t key = 0; key < 2 * pairs; ++key) {
+        check(tree.contains(key) == (key >= 2 * (pairs - window)), "last pairs kept");
+    }
+}
+
+} // anonymous namespace
+
+int main()
+{
+    check_operations();
+    check_references();
+    check_concurrent();
+    std::cout << "scapegoat tree checks passed" << std::endl;
+}
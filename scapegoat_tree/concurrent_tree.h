@@ -0,0 +1,173 @@
+#pragma once
+
+#include "scapegoattree.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace details {
+
+// count of readers inside, spread over cache lines so that readers of different threads do not share one
+class ReadIndicator
+{
+public:
+    void arrive()
+    {
+        m_shards[shard()].m_count.fetch_add(1);
+    }
+
+    void depart()
+    {
+        m_shards[shard()].m_count.fetch_sub(1);
+    }
+
+    bool empty() const
+    {
+        for (const auto & shard : m_shards) {
+            if (shard.m_count.load() != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr std::size_t shard_count = 16;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<std::int64_t> m_count = 0;
+    };
+
+    std::array<Shard, shard_count> m_shards;
+
+    static std::size_t shard()
+    {
+        thread_local const std::size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % shard_count;
+        return index;
+    }
+};
+
+} // namespace details
+
+// two copies of a tree, readers use one while the single writer changes the other, then they swap roles
+// readers never wait and never retry, a writer applies every change twice and waits for readers of the old copy to leave
+// (left-right technique: no node is changed or reused under a reader, no matter how much rebuilding a change causes)
+template <class Tree>
+class ConcurrentTree
+{
+public:
+    using key_type = typename Tree::key_type;
+    using value_type = typename Tree::value_type;
+
+    template <class... Args>
+    explicit ConcurrentTree(const Args &... args)
+        : m_trees{Tree(args...), Tree(args...)}
+    {
+    }
+
+    ConcurrentTree(const ConcurrentTree &) = delete;
+    ConcurrentTree & operator=(const ConcurrentTree &) = delete;
+
+    // calls 'read' with const tree no writer touches meanwhile, what it returns must not point into the tree
+    template <class Read>
+    decltype(auto) read(Read && read) const;
+
+    // calls 'write' on both copies one after another, it has to change them the same way and should not throw,
+    // result of the first call is returned and must not point into the tree
+    template <class Write>
+    auto write(Write && write);
+
+    bool contains(const key_type & key) const
+    {
+        return read([&key](const Tree & tree) { return tree.contains(key); });
+    }
+
+    std::size_t size() const
+    {
+        return read([](const Tree & tree) { return tree.size(); });
+    }
+
+    bool insert(const value_type & value)
+    {
+        return write([&value](Tree & tree) { return tree.insert(value).second; });
+    }
+
+    bool erase(const key_type & key)
+    {
+        return write([&key](Tree & tree) { return tree.erase(key) != 0; });
+    }
+
+private:
+    std::array<Tree, 2> m_trees;
+    std::atomic<unsigned> m_reading = 0; // copy readers go to
+    std::atomic<unsigned> m_version = 0; // indicator readers arrive at
+    mutable std::array<details::ReadIndicator, 2> m_readers;
+    std::mutex m_write_mutex;
+
+    // waits until every reader that might have seen the other copy is gone
+    void m_waitForReaders();
+};
+
+template <class Tree>
+template <class Read>
+inline decltype(auto) ConcurrentTree<Tree>::read(Read && read) const
+{
+    auto & readers = m_readers[m_version.load()];
+    readers.arrive();
+    struct Departure
+    {
+        details::ReadIndicator & m_readers;
+        ~Departure()
+        {
+            m_readers.depart();
+        }
+    } departure{readers};
+    return std::invoke(std::forward<Read>(read), std::as_const(m_trees[m_reading.load()]));
+}
+
+template <class Tree>
+template <class Write>
+inline auto ConcurrentTree<Tree>::write(Write && write)
+{
+    std::lock_guard lock(m_write_mutex);
+    const unsigned reading = m_reading.load();
+
+    // readers move to the changed copy, the other one gets the same change once they have left it
+    const auto catch_up = [&]() {
+        m_reading.store(1 - reading);
+        m_waitForReaders();
+        std::invoke(write, m_trees[reading]);
+    };
+
+    if constexpr (std::is_void_v<std::invoke_result_t<Write &, Tree &>>) {
+        std::invoke(write, m_trees[1 - reading]);
+        catch_up();
+    }
+    else {
+        auto result = std::invoke(write, m_trees[1 - reading]);
+        catch_up();
+        return result;
+    }
+}
+
+template <class Tree>
+inline void ConcurrentTree<Tree>::m_waitForReaders()
+{
+    const unsigned version = m_version.load();
+    const unsigned next = 1 - version;
+    while (!m_readers[next].empty()) {
+        std::this_thread::yield();
+    }
+    m_version.store(next);
+    while (!m_readers[version].empty()) {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,262 @@
+#include "scapegoattree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// differential fuzzer: input bytes pick operations made on ScapegoatTree and std::set alike, any difference aborts,
+// every input runs on 16 bit keys and on std::string keys long enough to live on the heap
+// built with -DSCAPEGOAT_LIBFUZZER and -fsanitize=fuzzer it is a libFuzzer target, otherwise main feeds it random inputs
+
+namespace {
+
+// keys from a small range so that operations hit present keys often
+constexpr unsigned key_range = 512;
+
+template <class Key>
+Key make_key(unsigned number)
+{
+    if constexpr (std::is_same_v<Key, std::string>) {
+        return std::string(16 + number % 8, 'k') + std::to_string(number);
+    }
+    else {
+        return static_cast<Key>(number);
+    }
+}
+
+class Input
+{
+public:
+    Input(const std::uint8_t * data, std::size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    bool empty() const
+    {
+        return m_position == m_size;
+    }
+
+    std::uint8_t byte()
+    {
+        return empty() ? 0 : m_data[m_position++];
+    }
+
+    // key number, make_key turns it into a key
+    unsigned number()
+    {
+        const unsigned high = byte();
+        return (high << 8 | byte()) % key_range;
+    }
+
+private:
+    const std::uint8_t * m_data;
+    std::size_t m_size;
+    std::size_t m_position = 0;
+};
+
+void check(bool condition, const char * what)
+{
+    if (!condition) {
+        std::cerr << "mismatch against std::set: " << what << std::endl;
+        std::abort();
+    }
+}
+
+template <class Tree, class Reference>
+void check_equal(const Tree & tree, const Reference & reference)
+{
+    check(tree.size() == reference.size(), "size");
+    check(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end()), "elements");
+    check(std::equal(tree.rbegin(), tree.rend(), reference.rbegin(), reference.rend()), "reverse elements");
+}
+
+// inserts go down at most ceil(log_{1/alpha} of the size) edges, removals let the size drop to alpha of what it was
+// before the whole tree is rebuilt, which is one level more
+std::size_t height_bound(std::size_t size, double alpha)
+{
+    return size == 0 ? 0 : static_cast<std::size_t>(std::ceil(std::log(size / alpha) / std::log(1 / alpha))) + 1;
+}
+
+// a few keys for bulk loads and set operations
+template <class Key>
+std::vector<Key> batch(Input & input)
+{
+    std::vector<Key> keys(input.byte() % 32);
+    for (auto & key : keys) {
+        key = make_key<Key>(input.number());
+    }
+    return keys;
+}
+
+template <class Key>
+std::set<Key> combine(const std::set<Key> & a, const std::set<Key> & b, std::uint8_t operation)
+{
+    std::set<Key> result;
+    const auto out = std::inserter(result, result.end());
+    switch (operation % 3) {
+    case 0:
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), out);
+        break;
+    case 1:
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), out);
+        break;
+    default:
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), out);
+        break;
+    }
+    return result;
+}
+
+template <class Key>
+ScapegoatTree<Key> combine(const ScapegoatTree<Key> & a, const ScapegoatTree<Key> & b, std::uint8_t operation, std::size_t threads)
+{
+    switch (operation % 3) {
+    case 0:
+        return merge_union(a, b, threads);
+    case 1:
+        return intersection(a, b, threads);
+    default:
+        return difference(a, b, threads);
+    }
+}
+
+template <class Key>
+void step(Input & input, ScapegoatTree<Key> & tree, std::set<Key> & reference, double alpha)
+{
+    using Tree = ScapegoatTree<Key>;
+    const std::uint8_t operation = input.byte();
+    const unsigned number = input.number();
+    const Key key = make_key<Key>(number);
+    switch (operation % 12) {
+    case 0:
+    case 1:
+    case 2:
+        check(tree.insert(key).second == reference.insert(key).second, "insert");
+        break;
+    case 3:
+    case 4:
+        check(tree.erase(key) == reference.erase(key), "erase");
+        break;
+    case 5: {
+        const auto it = tree.find(key);
+        const auto expected = reference.find(key);
+        check((it == tree.end()) == (expected == reference.end()), "find");
+        if (it != tree.end()) {
+            const auto next = tree.erase(it);
+            const auto expected_next = reference.erase(expected);
+            check((next == tree.end()) == (expected_next == reference.end()) && (next == tree.end() || *next == *expected_next), "erase iterator");
+        }
+        break;
+    }
+    case 6: {
+        const auto lower = tree.lower_bound(key);
+        const auto upper = tree.upper_bound(key);
+        const auto expected_lower = reference.lower_bound(key);
+        const auto expected_upper = reference.upper_bound(key);
+        check((lower == tree.end()) == (expected_lower == reference.end()) && (lower == tree.end() || *lower == *expected_lower), "lower_bound");
+        check((upper == tree.end()) == (expected_upper == reference.end()) && (upper == tree.end() || *upper == *expected_upper), "upper_bound");
+        check(tree.contains(key) == reference.contains(key), "contains");
+        break;
+    }
+    case 7: {
+        const std::size_t rank = std::distance(reference.begin(), reference.lower_bound(key));
+        check(tree.rank(key) == rank, "rank");
+        if (!reference.empty()) {
+            const std::size_t index = number % reference.size();
+            check(*tree.select(index) == *std::next(reference.begin(), index), "select");
+        }
+        const Key hi = make_key<Key>(input.number());
+        const std::size_t expected = key < hi ? std::distance(reference.lower_bound(key), reference.lower_bound(hi)) : 0;
+        check(tree.count_range(key, hi) == expected, "count_range");
+        break;
+    }
+    case 8: {
+        const auto keys = batch<Key>(input);
+        tree.insert_bulk(keys, 1 + operation / 12 % 4);
+        reference.insert(keys.begin(), keys.end());
+        break;
+    }
+    case 9: {
+        Tree greater = tree.split(key);
+        check(tree.empty() || *tree.rbegin() < key, "split lower part");
+        check(greater.empty() || *greater.begin() >= key, "split upper part");
+        check(tree.size() + greater.size() == reference.size(), "split sizes");
+        tree.join(std::move(greater));
+        break;
+    }
+    case 10: {
+        const auto keys = batch<Key>(input);
+        const Tree other(keys.begin(), keys.end());
+        const std::set<Key> other_reference(keys.begin(), keys.end());
+        tree = combine(tree, other, operation / 12, 1 + number % 4);
+        reference = combine(reference, other_reference, operation / 12);
+        break;
+    }
+    default: {
+        const auto frozen = tree.freeze();
+        check(frozen.size() == reference.size(), "frozen size");
+        check(frozen.contains(key) == reference.contains(key), "frozen contains");
+        const Key * lower = frozen.lower_bound(key);
+        const auto expected = reference.lower_bound(key);
+        check((lower == nullptr) == (expected == reference.end()) && (lower == nullptr || *lower == *expected), "frozen lower_bound");
+        const auto frozen_copy = frozen;
+        check(frozen_copy.size() == frozen.size() && frozen_copy.contains(key) == reference.contains(key), "frozen copy");
+        const Tree copy = tree;
+        check_equal(copy, reference);
+        break;
+    }
+    }
+    check(tree.size() == reference.size(), "size");
+    check(tree.height() <= height_bound(tree.size(), alpha), "height within the alpha bound");
+}
+
+// first byte picks alpha over [0.5, 1), the rest is a sequence of operations
+template <class Key>
+void run(const std::uint8_t * data, std::size_t size)
+{
+    Input input(data, size);
+    const double alpha = 0.5 + input.byte() % 50 / 100.0;
+    ScapegoatTree<Key> tree(alpha);
+    std::set<Key> reference;
+    while (!input.empty()) {
+        step(input, tree, reference, alpha);
+    }
+    check_equal(tree, reference);
+}
+
+} // anonymous namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t * data, std::size_t size)
+{
+    run<std::uint16_t>(data, size);
+    run<std::string>(data, size);
+    return 0;
+}
+
+#ifndef SCAPEGOAT_LIBFUZZER
+// usage: fuzz_scapegoattree [number of inputs] [seed]
+int main(int argc, char ** argv)
+{
+    const std::size_t runs = argc > 1 ? std::stoul(argv[1]) : 10'000;
+    std::mt19937_64 random(argc > 2 ? std::stoull(argv[2]) : 42);
+    std::vector<std::uint8_t> data;
+    for (std::size_t run = 0; run < runs; ++run) {
+        data.resize(random() % 4096);
+        for (auto & byte : data) {
+            byte = static_cast<std::uint8_t>(random());
+        }
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    std::cout << runs << " inputs, no mismatch" << std::endl;
+}
+#endif
@@ -1,10 +1,10 @@
-#include "ScapegoatTree.h"
+#include "scapegoattree.h"
 
 #include <iostream>
 
 int main()
 {
-    ScapegoatTree tree;
+    ScapegoatTree<int> tree;
     for (int i = 10; i > 0; --i) {
         tree.insert(i);
     }
@@ -1,63 +1,1781 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <stdexcept> // for std::invalid_argument, std::out_of_range, std::length_error exceptions
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
+
 namespace details {
+using NodeIndex = std::uint32_t;
+
+constexpr NodeIndex null_node = static_cast<NodeIndex>(-1);
+
+// what a tree stores: keys alone for a set, key and mapped value pairs for a map
+template <class Key, class Mapped>
+struct TreeTraits
+{
+    using value_type = std::pair<const Key, Mapped>;
+
+    static const Key & key(const value_type & value)
+    {
+        return value.first;
+    }
+};
+
+template <class Key>
+struct TreeTraits<Key, void>
+{
+    using value_type = Key;
+
+    static const Key & key(const value_type & value)
+    {
+        return value;
+    }
+};
+
+// comparator allowing lookup by keys of other types
+template <class Compare>
+concept Transparent = requires { typename Compare::is_transparent; };
+
+// value lives in raw storage, so free slots hold no object
+template <class Value>
 struct Node
 {
-    int m_depth;
-    int m_value;
-    std::size_t m_size;
+    NodeIndex m_size;
 
-    Node * m_left;
-    Node * m_right;
-    Node * m_parent;
+    NodeIndex m_left;
+    NodeIndex m_right;
+    NodeIndex m_parent;
 
-    Node() = default;
-    Node(int value);
+    alignas(Value) unsigned char m_storage[sizeof(Value)];
 
-    ~Node();
+    Value & value()
+    {
+        return *std::launder(reinterpret_cast<Value *>(m_storage));
+    }
+    const Value & value() const
+    {
+        return *std::launder(reinterpret_cast<const Value *>(m_storage));
+    }
 };
 
+// all nodes of a tree in chunks doubling in size, so nodes never move and are addressed by 32 bit index
+// free slots are chained through m_left
+template <class Value, class Allocator>
+class NodePool
+{
+public:
+    using node_type = Node<Value>;
+    using allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<node_type>;
+
+private:
+    using traits = std::allocator_traits<allocator_type>;
+
+    static constexpr unsigned first_chunk_bits = 4; // first chunk holds 16 nodes
+
+    [[no_unique_address]] allocator_type m_allocator;
+    std::vector<node_type *> m_chunks;
+    NodeIndex m_used = 0; // slots handed out at least once
+    NodeIndex m_free = null_node;
+
+    static std::size_t chunk_size(std::size_t chunk)
+    {
+        return std::size_t(1) << (chunk + first_chunk_bits);
+    }
+
+    // chunk and offset in it of slot 'index'
+    static std::pair<std::size_t, std::size_t> locate(NodeIndex index)
+    {
+        const std::uint64_t shifted = std::uint64_t(index) + (std::uint64_t(1) << first_chunk_bits);
+        const unsigned top = std::bit_width(shifted) - 1;
+        return {top - first_chunk_bits, shifted - (std::uint64_t(1) << top)};
+    }
+
+public:
+    explicit NodePool(const Allocator & allocator)
+        : m_allocator(allocator)
+    {
+    }
+
+    NodePool(const NodePool &) = delete;
+    NodePool & operator=(const NodePool &) = delete;
+
+    ~NodePool()
+    {
+        release();
+    }
+
+    // constructs value in a free slot, the node gets no links
+    template <class... Args>
+    NodeIndex create(Args &&... args);
+
+    // destroys value and frees its slot
+    void destroy(NodeIndex index);
+
+    // frees memory of all slots, their values have to be destroyed already
+    void release();
+
+    void swap(NodePool & other) noexcept;
+
+    Allocator get_allocator() const
+    {
+        return Allocator(m_allocator);
+    }
+
+    node_type & operator[](NodeIndex index)
+    {
+        const auto [chunk, offset] = locate(index);
+        return m_chunks[chunk][offset];
+    }
+    const node_type & operator[](NodeIndex index) const
+    {
+        const auto [chunk, offset] = locate(index);
+        return m_chunks[chunk][offset];
+    }
+};
+
+template <class Value, class Allocator>
+template <class... Args>
+inline NodeIndex NodePool<Value, Allocator>::create(Args &&... args)
+{
+    const bool reused = m_free != null_node;
+    const NodeIndex index = reused ? m_free : m_used;
+    if (!reused) {
+        if (m_used == null_node) {
+            throw std::length_error("too many nodes in the tree");
+        }
+        if (locate(index).first == m_chunks.size()) {
+            m_chunks.reserve(m_chunks.size() + 1);
+            m_chunks.push_back(traits::allocate(m_allocator, chunk_size(m_chunks.size())));
+        }
+    }
+
+    node_type & node = (*this)[index];
+    // slot is taken only once the value is built, so a throwing constructor loses nothing
+    traits::construct(m_allocator, reinterpret_cast<Value *>(node.m_storage), std::forward<Args>(args)...);
+    if (reused) {
+        m_free = node.m_left;
+    }
+    else {
+        ++m_used;
+    }
+
+    node.m_size = 1;
+    node.m_left = null_node;
+    node.m_right = null_node;
+    node.m_parent = null_node;
+    return index;
+}
+
+template <class Value, class Allocator>
+inline void NodePool<Value, Allocator>::destroy(NodeIndex index)
+{
+    node_type & node = (*this)[index];
+    traits::destroy(m_allocator, &node.value());
+    node.m_left = m_free;
+    m_free = index;
+}
+
+template <class Value, class Allocator>
+inline void NodePool<Value, Allocator>::release()
+{
+    for (std::size_t chunk = 0; chunk < m_chunks.size(); ++chunk) {
+        traits::deallocate(m_allocator, m_chunks[chunk], chunk_size(chunk));
+    }
+    m_chunks.clear();
+    m_used = 0;
+    m_free = null_node;
+}
+
+template <class Value, class Allocator>
+inline void NodePool<Value, Allocator>::swap(NodePool & other) noexcept
+{
+    using std::swap;
+    swap(m_allocator, other.m_allocator);
+    swap(m_chunks, other.m_chunks);
+    swap(m_used, other.m_used);
+    swap(m_free, other.m_free);
+}
+
+// stable sort of [first, last): slices are sorted on 'threads' threads, then merged pairwise the same way
+template <class RandomIt, class Less>
+void parallel_sort(RandomIt first, RandomIt last, Less less, std::size_t threads)
+{
+    const std::size_t count = last - first;
+    if (threads <= 1 || count < 2 * threads) {
+        std::stable_sort(first, last, less);
+        return;
+    }
+
+    std::vector<RandomIt> bounds;
+    for (std::size_t i = 0; i <= threads; ++i) {
+        bounds.push_back(first + count * i / threads);
+    }
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() { std::stable_sort(bounds[i], bounds[i + 1], less); });
+    }
+    for (auto & worker : workers) {
+        worker.join();
+    }
+
+    for (std::size_t step = 1; step < threads; step *= 2) {
+        workers.clear();
+        for (std::size_t i = 0; i + step < threads; i += 2 * step) {
+            workers.emplace_back([&, i]() { std::inplace_merge(bounds[i], bounds[i + step], bounds[std::min(i + 2 * step, threads)], less); });
+        }
+        for (auto & worker : workers) {
+            worker.join();
+        }
+    }
+}
+
 } // namespace details
 
-class ScapegoatTree
+template <class Key, class Mapped, class Compare, class Allocator>
+class FrozenTree;
+
+// ordered container of unique keys, a set if Mapped is void and a map otherwise
+// nodes never move: iterators and references stay valid until their own element is erased
+template <class Key, class Mapped, class Compare, class Allocator>
+class BasicScapegoatTree
 {
+    using traits = details::TreeTraits<Key, Mapped>;
+    static constexpr bool is_set = std::is_void_v<Mapped>;
+
+public:
+    using key_type = Key;
+    using mapped_type = Mapped;
+    using value_type = typename traits::value_type;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+
 private:
-    std::size_t m_size;
+    template <bool is_const>
+    class Iterator
+    {
+        friend class BasicScapegoatTree;
+        template <bool>
+        friend class Iterator;
+
+        using tree_pointer = std::conditional_t<is_const, const BasicScapegoatTree *, BasicScapegoatTree *>;
+
+    public:
+        using value_type = typename BasicScapegoatTree::value_type;
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<is_const, const value_type *, value_type *>;
+        using reference = std::conditional_t<is_const, const value_type &, value_type &>;
+
+        Iterator() = default;
+
+        // iterator converts to const_iterator
+        template <bool other_const>
+        Iterator(const Iterator<other_const> & other) requires(is_const && !other_const)
+            : m_tree(other.m_tree)
+            , m_node(other.m_node)
+        {
+        }
+
+        reference operator*() const
+        {
+            return m_tree->m_nodes[m_node].value();
+        }
+
+        pointer operator->() const
+        {
+            return &m_tree->m_nodes[m_node].value();
+        }
+
+        Iterator & operator++()
+        {
+            m_node = m_tree->m_next(m_node);
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            auto tmp = *this;
+            operator++();
+            return tmp;
+        }
+
+        Iterator & operator--()
+        {
+            m_node = m_tree->m_prev(m_node);
+            return *this;
+        }
+
+        Iterator operator--(int)
+        {
+            auto tmp = *this;
+            operator--();
+            return tmp;
+        }
+
+        friend bool operator==(const Iterator & a, const Iterator & b)
+        {
+            return a.m_node == b.m_node;
+        }
+
+    private:
+        tree_pointer m_tree = nullptr;
+        details::NodeIndex m_node = details::null_node;
+
+        Iterator(tree_pointer tree, details::NodeIndex node)
+            : m_tree(tree)
+            , m_node(node)
+        {
+        }
+    };
+
+public:
+    using iterator = Iterator<is_set>; // keys of a set are never mutable
+    using const_iterator = Iterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+private:
+    // void for a set, so the map only members below stay declarable
+    using mapped_reference = std::add_lvalue_reference_t<Mapped>;
+    using const_mapped_reference = std::add_lvalue_reference_t<const Mapped>;
+
+    // where a key is or would be inserted
+    struct Position
+    {
+        details::NodeIndex m_parent = details::null_node;
+        bool m_to_right = false;
+        int m_depth = 0;                                 // of the new node, counted while descending
+        details::NodeIndex m_found = details::null_node; // node with equal key
+    };
+
+    std::size_t m_size = 0;
+    std::size_t m_maxSize = 0; // the most elements since the last rebuild of the whole tree
     double m_alpha;
     double m_log;
+    [[no_unique_address]] Compare m_compare;
+
+    details::NodePool<value_type, Allocator> m_nodes;
+    details::NodeIndex m_root = details::null_node;
+
+    // node indices in order, memory from the tree's allocator as well
+    using IndexVector = std::vector<details::NodeIndex, typename std::allocator_traits<Allocator>::template rebind_alloc<details::NodeIndex>>;
+
+    // scratch of m_rebuildSubtree, kept to not allocate on every rebuild
+    IndexVector m_slots;
 
-    details::Node * m_root;
+    std::size_t m_rebuilds = 0;
+    std::size_t m_rebuiltNodes = 0;
 
-    static int m_nodeSize(details::Node * ptr);
+    std::size_t m_nodeSize(details::NodeIndex ptr) const;
 
-    details::Node * m_findScapegoat(details::Node * start) const;
-    details::Node * m_insertKey(details::Node *& ptr, int value, int depth = 0);
-    void m_rebuildSubtree(details::Node *& scapegoat);
-    void m_insertMiddle(std::vector<int> & values, details::Node *& ptr, details::Node * parent, int beg, int end);
+    template <class K>
+    Position m_position(const K & key) const;
+    void m_attach(details::NodeIndex node, const Position & position);
+    template <class K, class... Args>
+    std::pair<iterator, bool> m_tryEmplace(K && key, Args &&... args);
 
-    static details::Node * m_find(details::Node * start, int value);
+    details::NodeIndex m_findScapegoat(details::NodeIndex start) const;
+    void m_rebuildSubtree(details::NodeIndex scapegoat);
+    void m_flatten(details::NodeIndex ptr);
+    details::NodeIndex m_insertMiddle(details::NodeIndex parent, std::size_t beg, std::size_t end);
+    void m_destroySubtree(details::NodeIndex ptr);
+    void m_mergeBatch(IndexVector & batch);
+    template <class Operation>
+    static BasicScapegoatTree m_combine(const BasicScapegoatTree & a, const BasicScapegoatTree & b, std::size_t threads, Operation operation);
 
-    details::Node * m_minNode(details::Node * ptr);
-    bool m_removeKey(details::Node * ptr, int value);
-    bool m_killKey(details::Node * ptr);
-    void m_killKeyParentInit(details::Node *& parent, details::Node * child, details::Node *& child_ptr);
+    template <class K>
+    details::NodeIndex m_find(details::NodeIndex start, const K & key) const;
+    template <class K>
+    details::NodeIndex m_lowerBound(const K & key) const;
+    template <class K>
+    details::NodeIndex m_upperBound(const K & key) const;
+    template <class K>
+    std::size_t m_rank(const K & key) const;
+    details::NodeIndex m_select(std::size_t index) const;
 
-    static void m_values(std::vector<int> & arr, details::Node * ptr);
-    static std::vector<int> m_values(details::Node * ptr);
+    details::NodeIndex m_minNode(details::NodeIndex ptr) const;
+    details::NodeIndex m_maxNode(details::NodeIndex ptr) const;
+    details::NodeIndex m_next(details::NodeIndex ptr) const;
+    details::NodeIndex m_prev(details::NodeIndex ptr) const;
+
+    void m_erase(details::NodeIndex ptr);
+    void m_killKey(details::NodeIndex ptr);
+    void m_killKeyParentInit(details::NodeIndex parent, details::NodeIndex child, details::NodeIndex child_ptr);
 
 public:
-    ScapegoatTree();
-    ScapegoatTree(double alpha);
+    BasicScapegoatTree()
+        : BasicScapegoatTree(0.75)
+    {
+    }
+
+    // for allocators without a default constructor, like PoolStdAllocator
+    explicit BasicScapegoatTree(const Allocator & allocator)
+        : BasicScapegoatTree(0.75, Compare(), allocator)
+    {
+    }
+
+    explicit BasicScapegoatTree(double alpha, const Compare & compare = Compare(), const Allocator & allocator = Allocator());
+
+    template <std::input_iterator InputIt>
+    BasicScapegoatTree(InputIt first, InputIt last, double alpha = 0.75, const Compare & compare = Compare(), const Allocator & allocator = Allocator())
+        : BasicScapegoatTree(alpha, compare, allocator)
+    {
+        insert_bulk(std::ranges::subrange(first, last));
+    }
+
+    BasicScapegoatTree(const BasicScapegoatTree & other);
+
+    BasicScapegoatTree(BasicScapegoatTree && other) noexcept
+        : BasicScapegoatTree(other.m_alpha, other.m_compare, other.m_nodes.get_allocator())
+    {
+        swap(other);
+    }
+
+    BasicScapegoatTree & operator=(BasicScapegoatTree other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~BasicScapegoatTree()
+    {
+        m_destroySubtree(m_root);
+    }
+
+    void swap(BasicScapegoatTree & other) noexcept;
+
+    friend void swap(BasicScapegoatTree & a, BasicScapegoatTree & b) noexcept
+    {
+        a.swap(b);
+    }
+
+    iterator begin()
+    {
+        return iterator(this, m_root == details::null_node ? details::null_node : m_minNode(m_root));
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(this, m_root == details::null_node ? details::null_node : m_minNode(m_root));
+    }
+    const_iterator cbegin() const
+    {
+        return begin();
+    }
+
+    iterator end()
+    {
+        return iterator(this, details::null_node);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(this, details::null_node);
+    }
+    const_iterator cend() const
+    {
+        return end();
+    }
+
+    reverse_iterator rbegin()
+    {
+        return reverse_iterator(end());
+    }
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator(end());
+    }
+    reverse_iterator rend()
+    {
+        return reverse_iterator(begin());
+    }
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_root == details::null_node;
+    }
+
+    void clear();
+
+    struct RebuildStats
+    {
+        std::size_t rebuilds;      // of scapegoat subtrees and of the whole tree after removals
+        std::size_t rebuilt_nodes; // in all of them
+    };
+
+    // counted since the tree was created
+    RebuildStats rebuild_stats() const
+    {
+        return {m_rebuilds, m_rebuiltNodes};
+    }
+
+    // number of levels, walks the whole tree
+    std::size_t height() const;
+
+    std::pair<iterator, bool> insert(const value_type & value)
+    {
+        return emplace(value);
+    }
+    std::pair<iterator, bool> insert(value_type && value)
+    {
+        return emplace(std::move(value));
+    }
+
+    template <std::input_iterator InputIt>
+    void insert(InputIt first, InputIt last)
+    {
+        insert_bulk(std::ranges::subrange(first, last));
+    }
+
+    // sorts batch (on 'threads' threads) and merges it with the tree into a perfectly balanced one in O(n + m),
+    // of equal keys the one already in the tree or met first in the batch stays
+    template <std::ranges::input_range Range>
+    void insert_bulk(Range && range, std::size_t threads = 1);
+
+    // builds value first to learn its key, it is destroyed again if the key is present
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args &&... args);
+
+    // builds nothing if the key is present
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const key_type & key, Args &&... args) requires(!is_set)
+    {
+        return m_tryEmplace(key, std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(key_type && key, Args &&... args) requires(!is_set)
+    {
+        return m_tryEmplace(std::move(key), std::forward<Args>(args)...);
+    }
 
-    bool contains(int value) const;
-    bool insert(int value);
-    bool remove(int value);
+    mapped_reference operator[](const key_type & key) requires(!is_set)
+    {
+        return try_emplace(key).first->second;
+    }
+    mapped_reference operator[](key_type && key) requires(!is_set)
+    {
+        return try_emplace(std::move(key)).first->second;
+    }
 
-    std::size_t size() const;
-    bool empty() const;
+    // throws std::out_of_range if the key is absent
+    mapped_reference at(const key_type & key) requires(!is_set);
+    const_mapped_reference at(const key_type & key) const requires(!is_set);
 
-    std::vector<int> values() const;
+    size_type erase(const key_type & key);
+    iterator erase(const_iterator pos);
 
-    ~ScapegoatTree();
+    bool remove(const key_type & key)
+    {
+        return erase(key) != 0;
+    }
+
+    iterator find(const key_type & key)
+    {
+        return iterator(this, m_find(m_root, key));
+    }
+    const_iterator find(const key_type & key) const
+    {
+        return const_iterator(this, m_find(m_root, key));
+    }
+    template <class K>
+    iterator find(const K & key) requires details::Transparent<Compare>
+    {
+        return iterator(this, m_find(m_root, key));
+    }
+    template <class K>
+    const_iterator find(const K & key) const requires details::Transparent<Compare>
+    {
+        return const_iterator(this, m_find(m_root, key));
+    }
+
+    bool contains(const key_type & key) const
+    {
+        return m_find(m_root, key) != details::null_node;
+    }
+    template <class K>
+    bool contains(const K & key) const requires details::Transparent<Compare>
+    {
+        return m_find(m_root, key) != details::null_node;
+    }
+
+    size_type count(const key_type & key) const
+    {
+        return contains(key);
+    }
+    template <class K>
+    size_type count(const K & key) const requires details::Transparent<Compare>
+    {
+        return contains(key);
+    }
+
+    // first element not less than key
+    iterator lower_bound(const key_type & key)
+    {
+        return iterator(this, m_lowerBound(key));
+    }
+    const_iterator lower_bound(const key_type & key) const
+    {
+        return const_iterator(this, m_lowerBound(key));
+    }
+    template <class K>
+    iterator lower_bound(const K & key) requires details::Transparent<Compare>
+    {
+        return iterator(this, m_lowerBound(key));
+    }
+    template <class K>
+    const_iterator lower_bound(const K & key) const requires details::Transparent<Compare>
+    {
+        return const_iterator(this, m_lowerBound(key));
+    }
+
+    // first element greater than key
+    iterator upper_bound(const key_type & key)
+    {
+        return iterator(this, m_upperBound(key));
+    }
+    const_iterator upper_bound(const key_type & key) const
+    {
+        return const_iterator(this, m_upperBound(key));
+    }
+    template <class K>
+    iterator upper_bound(const K & key) requires details::Transparent<Compare>
+    {
+        return iterator(this, m_upperBound(key));
+    }
+    template <class K>
+    const_iterator upper_bound(const K & key) const requires details::Transparent<Compare>
+    {
+        return const_iterator(this, m_upperBound(key));
+    }
+
+    std::pair<iterator, iterator> equal_range(const key_type & key)
+    {
+        return {lower_bound(key), upper_bound(key)};
+    }
+    std::pair<const_iterator, const_iterator> equal_range(const key_type & key) const
+    {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+    // number of elements less than key
+    size_type rank(const key_type & key) const
+    {
+        return m_rank(key);
+    }
+    template <class K>
+    size_type rank(const K & key) const requires details::Transparent<Compare>
+    {
+        return m_rank(key);
+    }
+
+    // element with 'index' elements less than it, end() if index >= size()
+    iterator select(size_type index)
+    {
+        return iterator(this, m_select(index));
+    }
+    const_iterator select(size_type index) const
+    {
+        return const_iterator(this, m_select(index));
+    }
+
+    // number of elements in [lo, hi)
+    size_type count_range(const key_type & lo, const key_type & hi) const
+    {
+        return m_compare(lo, hi) ? m_rank(hi) - m_rank(lo) : 0;
+    }
+    template <class K>
+    size_type count_range(const K & lo, const K & hi) const requires details::Transparent<Compare>
+    {
+        return m_compare(lo, hi) ? m_rank(hi) - m_rank(lo) : 0;
+    }
+
+    // elements in [lo, hi) in order
+    std::ranges::subrange<iterator> range(const key_type & lo, const key_type & hi)
+    {
+        return m_compare(lo, hi) ? std::ranges::subrange(lower_bound(lo), lower_bound(hi)) : std::ranges::subrange(end(), end());
+    }
+    std::ranges::subrange<const_iterator> range(const key_type & lo, const key_type & hi) const
+    {
+        return m_compare(lo, hi) ? std::ranges::subrange(lower_bound(lo), lower_bound(hi)) : std::ranges::subrange(end(), end());
+    }
+
+    key_compare key_comp() const
+    {
+        return m_compare;
+    }
+
+    allocator_type get_allocator() const
+    {
+        return m_nodes.get_allocator();
+    }
+
+    // all elements in order
+    std::vector<value_type> values() const
+    {
+        return {begin(), end()};
+    }
+
+    // moves elements not less than key out into returned tree, both are rebuilt balanced in O(n)
+    BasicScapegoatTree split(const key_type & key);
+
+    // moves all elements of other in, its keys have to be greater than all of this tree (std::invalid_argument otherwise)
+    void join(BasicScapegoatTree && other);
+
+    // set operations over both in order sequences in O(n + m), result is built balanced right away
+    // 'threads' split key range between them, each merges its own part
+    friend BasicScapegoatTree merge_union(const BasicScapegoatTree & a, const BasicScapegoatTree & b, std::size_t threads = 1)
+    {
+        return m_combine(a, b, threads, [](auto... args) { return std::set_union(args...); });
+    }
+    friend BasicScapegoatTree intersection(const BasicScapegoatTree & a, const BasicScapegoatTree & b, std::size_t threads = 1)
+    {
+        return m_combine(a, b, threads, [](auto... args) { return std::set_intersection(args...); });
+    }
+    friend BasicScapegoatTree difference(const BasicScapegoatTree & a, const BasicScapegoatTree & b, std::size_t threads = 1)
+    {
+        return m_combine(a, b, threads, [](auto... args) { return std::set_difference(args...); });
+    }
+
+    // immutable copy for read mostly phases, searched much faster than the tree
+    FrozenTree<Key, Mapped, Compare, Allocator> freeze() const;
 };
+
+// elements sorted in Eytzinger order: levels of a complete binary search tree one after another,
+// children of k-th element (from 1) are 2k-th and (2k + 1)-th, so a search needs no links and no branches
+template <class Key, class Mapped, class Compare, class Allocator>
+class FrozenTree
+{
+    using traits = details::TreeTraits<Key, Mapped>;
+
+public:
+    using key_type = Key;
+    using value_type = typename traits::value_type;
+    using size_type = std::size_t;
+    using key_compare = Compare;
+
+    FrozenTree() = default;
+
+    // takes elements from a random access range sorted by compare without equal keys
+    template <std::ranges::random_access_range Sorted>
+    explicit FrozenTree(const Sorted & sorted, const Compare & compare = Compare(), const Allocator & allocator = Allocator());
+
+    FrozenTree(const FrozenTree & other);
+
+    FrozenTree(FrozenTree && other) noexcept
+        : m_compare(other.m_compare)
+        , m_allocator(other.m_allocator)
+    {
+        swap(other);
+    }
+
+    FrozenTree & operator=(FrozenTree other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~FrozenTree()
+    {
+        m_release();
+    }
+
+    void swap(FrozenTree & other) noexcept
+    {
+        using std::swap;
+        swap(m_compare, other.m_compare);
+        swap(m_allocator, other.m_allocator);
+        swap(m_lines, other.m_lines);
+        swap(m_lineCount, other.m_lineCount);
+        swap(m_size, other.m_size);
+    }
+
+    friend void swap(FrozenTree & a, FrozenTree & b) noexcept
+    {
+        a.swap(b);
+    }
+
+    size_type size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    // first element not less than key, nullptr if there is none
+    const value_type * lower_bound(const key_type & key) const
+    {
+        return m_lowerBound(key);
+    }
+    template <class K>
+    const value_type * lower_bound(const K & key) const requires details::Transparent<Compare>
+    {
+        return m_lowerBound(key);
+    }
+
+    // first element greater than key, nullptr if there is none
+    const value_type * upper_bound(const key_type & key) const
+    {
+        return m_upperBound(key);
+    }
+    template <class K>
+    const value_type * upper_bound(const K & key) const requires details::Transparent<Compare>
+    {
+        return m_upperBound(key);
+    }
+
+    bool contains(const key_type & key) const
+    {
+        const value_type * found = m_lowerBound(key);
+        return found != nullptr && !m_compare(key, traits::key(*found));
+    }
+    template <class K>
+    bool contains(const K & key) const requires details::Transparent<Compare>
+    {
+        const value_type * found = m_lowerBound(key);
+        return found != nullptr && !m_compare(key, traits::key(*found));
+    }
+
+private:
+    struct alignas(64) CacheLine
+    {
+        std::byte m_bytes[64];
+    };
+
+    using line_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<CacheLine>;
+    using value_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<value_type>;
+
+    // elements sharing a cache line, the line holding descendants of k four levels below (for 16 per line) is fetched ahead:
+    // with k-th element at k on 64 bytes aligned storage they are (k * line_elements)-th to the next line_elements - 1
+    static constexpr std::size_t line_elements = std::bit_floor(std::max<std::size_t>(1, 64 / sizeof(value_type)));
+
+    [[no_unique_address]] Compare m_compare;
+    [[no_unique_address]] line_allocator m_allocator;
+    CacheLine * m_lines = nullptr; // place 0 is left empty
+    std::size_t m_lineCount = 0;
+    std::size_t m_size = 0;
+
+    // k-th element (from 1) at m_elements()[k]
+    value_type * m_elements() const
+    {
+        return reinterpret_cast<value_type *>(m_lines);
+    }
+
+    // storage for count elements after place 0
+    void m_allocate(std::size_t count);
+
+    template <class Source>
+    void m_push(Source && source);
+
+    void m_release() noexcept;
+
+    template <class K>
+    const value_type * m_lowerBound(const K & key) const
+    {
+        return m_descend([&](const value_type & value) { return m_compare(traits::key(value), key); });
+    }
+
+    template <class K>
+    const value_type * m_upperBound(const K & key) const
+    {
+        return m_descend([&](const value_type & value) { return !m_compare(key, traits::key(value)); });
+    }
+
+    // goes right while 'to_right' holds and returns the last element it went left from
+    template <class ToRight>
+    const value_type * m_descend(ToRight to_right) const;
+};
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <std::ranges::random_access_range Sorted>
+inline FrozenTree<Key, Mapped, Compare, Allocator>::FrozenTree(const Sorted & sorted, const Compare & compare, const Allocator & allocator)
+    : m_compare(compare)
+    , m_allocator(allocator)
+{
+    const std::size_t count = std::ranges::size(sorted);
+    const auto first = std::ranges::begin(sorted);
+
+    // in order walk over the implicit tree gives sorted rank of every position
+    std::vector<std::size_t> ranks(count + 1);
+    std::size_t rank = 0;
+    std::size_t k = count == 0 ? 0 : 1;
+    while (k != 0 && 2 * k <= count) {
+        k *= 2;
+    }
+    while (k != 0) {
+        ranks[k] = rank++;
+        if (2 * k + 1 <= count) {
+            k = 2 * k + 1;
+            while (2 * k <= count) {
+                k *= 2;
+            }
+        }
+        else {
+            // climb over right children, parent of the left one is next
+            while (k & 1) {
+                k >>= 1;
+            }
+            k >>= 1;
+        }
+    }
+
+    m_allocate(count);
+    try {
+        for (k = 1; k <= count; ++k) {
+            m_push(first[ranks[k]]);
+        }
+    }
+    catch (...) {
+        m_release();
+        throw;
+    }
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline FrozenTree<Key, Mapped, Compare, Allocator>::FrozenTree(const FrozenTree & other)
+    : m_compare(other.m_compare)
+    , m_allocator(std::allocator_traits<line_allocator>::select_on_container_copy_construction(other.m_allocator))
+{
+    m_allocate(other.m_size);
+    try {
+        for (std::size_t k = 1; k <= other.m_size; ++k) {
+            m_push(other.m_elements()[k]);
+        }
+    }
+    catch (...) {
+        m_release();
+        throw;
+    }
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void FrozenTree<Key, Mapped, Compare, Allocator>::m_allocate(std::size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    m_lineCount = ((count + 1) * sizeof(value_type) + sizeof(CacheLine) - 1) / sizeof(CacheLine);
+    m_lines = std::allocator_traits<line_allocator>::allocate(m_allocator, m_lineCount);
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class Source>
+inline void FrozenTree<Key, Mapped, Compare, Allocator>::m_push(Source && source)
+{
+    value_allocator allocator(m_allocator);
+    std::allocator_traits<value_allocator>::construct(allocator, m_elements() + m_size + 1, std::forward<Source>(source));
+    ++m_size;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void FrozenTree<Key, Mapped, Compare, Allocator>::m_release() noexcept
+{
+    value_allocator allocator(m_allocator);
+    for (; m_size > 0; --m_size) {
+        std::allocator_traits<value_allocator>::destroy(allocator, m_elements() + m_size);
+    }
+    if (m_lines != nullptr) {
+        std::allocator_traits<line_allocator>::deallocate(m_allocator, m_lines, m_lineCount);
+        m_lines = nullptr;
+        m_lineCount = 0;
+    }
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class ToRight>
+inline auto FrozenTree<Key, Mapped, Compare, Allocator>::m_descend(ToRight to_right) const -> const value_type *
+{
+    const std::size_t count = m_size;
+    const value_type * data = m_elements();
+    std::size_t k = 1;
+    while (k <= count) {
+#if defined(__GNUC__)
+        // address only, it may lie past the end and is never dereferenced
+        __builtin_prefetch(reinterpret_cast<const void *>(reinterpret_cast<std::uintptr_t>(data) + k * line_elements * sizeof(value_type)));
+#endif
+        k = 2 * k + to_right(data[k]);
+    }
+    // drop right turns made after the last left one and that one too
+    k >>= std::countr_one(k) + 1;
+    return k == 0 ? nullptr : data + k;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline FrozenTree<Key, Mapped, Compare, Allocator> BasicScapegoatTree<Key, Mapped, Compare, Allocator>::freeze() const
+{
+    std::vector<const value_type *> sorted;
+    sorted.reserve(m_size);
+    for (const auto & value : *this) {
+        sorted.push_back(&value);
+    }
+    const auto dereference = [](const value_type * value) -> const value_type & { return *value; };
+    return FrozenTree<Key, Mapped, Compare, Allocator>(sorted | std::views::transform(dereference), m_compare, get_allocator());
+}
+
+template <class Key, class Compare = std::less<Key>, class Allocator = std::allocator<Key>>
+using ScapegoatTree = BasicScapegoatTree<Key, void, Compare, Allocator>;
+
+template <class Key, class T, class Compare = std::less<Key>, class Allocator = std::allocator<std::pair<const Key, T>>>
+using ScapegoatMap = BasicScapegoatTree<Key, T, Compare, Allocator>;
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline BasicScapegoatTree<Key, Mapped, Compare, Allocator>::BasicScapegoatTree(double alpha, const Compare & compare, const Allocator & allocator)
+    : m_alpha(alpha)
+    , m_compare(compare)
+    , m_nodes(allocator)
+    , m_slots(allocator)
+{
+    if (0.5 > alpha || alpha >= 1) {
+        throw std::invalid_argument("alpha must be [0.5, 1)");
+    }
+    m_log = std::log(1 / alpha);
+}
+
+// copy is built balanced straight from the ordered elements
+template <class Key, class Mapped, class Compare, class Allocator>
+inline BasicScapegoatTree<Key, Mapped, Compare, Allocator>::BasicScapegoatTree(const BasicScapegoatTree & other)
+    : BasicScapegoatTree(other.m_alpha, other.m_compare, std::allocator_traits<Allocator>::select_on_container_copy_construction(other.m_nodes.get_allocator()))
+{
+    m_slots.reserve(other.m_size);
+    try {
+        for (const auto & value : other) {
+            m_slots.push_back(m_nodes.create(value));
+        }
+    }
+    catch (...) {
+        for (const auto slot : m_slots) {
+            m_nodes.destroy(slot);
+        }
+        throw;
+    }
+    m_root = m_insertMiddle(details::null_node, 0, m_slots.size());
+    m_size = m_maxSize = other.m_size;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::swap(BasicScapegoatTree & other) noexcept
+{
+    using std::swap;
+    swap(m_size, other.m_size);
+    swap(m_maxSize, other.m_maxSize);
+    swap(m_alpha, other.m_alpha);
+    swap(m_log, other.m_log);
+    swap(m_compare, other.m_compare);
+    m_nodes.swap(other.m_nodes);
+    swap(m_root, other.m_root);
+    swap(m_slots, other.m_slots);
+    swap(m_rebuilds, other.m_rebuilds);
+    swap(m_rebuiltNodes, other.m_rebuiltNodes);
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::clear()
+{
+    m_destroySubtree(m_root);
+    m_nodes.release();
+    m_root = details::null_node;
+    m_size = m_maxSize = 0;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline std::size_t BasicScapegoatTree<Key, Mapped, Compare, Allocator>::height() const
+{
+    std::size_t height = 0;
+    std::vector<std::pair<details::NodeIndex, std::size_t>> stack; // node and its level
+    if (m_root != details::null_node) {
+        stack.emplace_back(m_root, 1);
+    }
+    while (!stack.empty()) {
+        const auto [ptr, level] = stack.back();
+        stack.pop_back();
+        height = std::max(height, level);
+        for (const auto child : {m_nodes[ptr].m_left, m_nodes[ptr].m_right}) {
+            if (child != details::null_node) {
+                stack.emplace_back(child, level + 1);
+            }
+        }
+    }
+    return height;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline std::size_t BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_nodeSize(details::NodeIndex ptr) const
+{
+    if (ptr == details::null_node) {
+        return 0;
+    }
+    return m_nodes[ptr].m_size;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class... Args>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::emplace(Args &&... args) -> std::pair<iterator, bool>
+{
+    const details::NodeIndex node = m_nodes.create(std::forward<Args>(args)...);
+    const Position position = m_position(traits::key(m_nodes[node].value()));
+    if (position.m_found != details::null_node) {
+        m_nodes.destroy(node);
+        return {iterator(this, position.m_found), false};
+    }
+    m_attach(node, position);
+    return {iterator(this, node), true};
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class K, class... Args>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_tryEmplace(K && key, Args &&... args) -> std::pair<iterator, bool>
+{
+    const Position position = m_position(key);
+    if (position.m_found != details::null_node) {
+        return {iterator(this, position.m_found), false};
+    }
+    const details::NodeIndex node = m_nodes.create(std::piecewise_construct,
+                                                   std::forward_as_tuple(std::forward<K>(key)),
+                                                   std::forward_as_tuple(std::forward<Args>(args)...));
+    m_attach(node, position);
+    return {iterator(this, node), true};
+}
+
+// descend from root to the node with key or to the free place for it
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class K>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_position(const K & key) const -> Position
+{
+    Position position;
+    details::NodeIndex ptr = m_root;
+    while (ptr != details::null_node) {
+        const auto & ptr_key = traits::key(m_nodes[ptr].value());
+        if (m_compare(key, ptr_key)) {
+            position.m_to_right = false;
+        }
+        else if (m_compare(ptr_key, key)) {
+            position.m_to_right = true;
+        }
+        else {
+            position.m_found = ptr;
+            return position;
+        }
+        position.m_parent = ptr;
+        ++position.m_depth;
+        ptr = position.m_to_right ? m_nodes[ptr].m_right : m_nodes[ptr].m_left;
+    }
+    return position;
+}
+
+// link new node at position and restore balance if it went too deep
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_attach(details::NodeIndex node, const Position & position)
+{
+    m_nodes[node].m_parent = position.m_parent;
+    if (position.m_parent == details::null_node) {
+        m_root = node;
+    }
+    else {
+        (position.m_to_right ? m_nodes[position.m_parent].m_right : m_nodes[position.m_parent].m_left) = node;
+    }
+    for (details::NodeIndex i = position.m_parent; i != details::null_node; i = m_nodes[i].m_parent) {
+        ++m_nodes[i].m_size;
+    }
+    ++m_size;
+    m_maxSize = std::max(m_maxSize, m_size);
+
+    if (position.m_depth > std::ceil(std::log(m_size) / m_log)) {
+        details::NodeIndex scapegoat = m_findScapegoat(node);
+        m_rebuildSubtree(scapegoat);
+    }
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <std::ranges::input_range Range>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::insert_bulk(Range && range, std::size_t threads)
+{
+    // values are built in place right away, only their indices are sorted
+    IndexVector batch(m_slots.get_allocator());
+    if constexpr (std::ranges::sized_range<Range>) {
+        batch.reserve(std::ranges::size(range));
+    }
+    try {
+        for (auto && value : range) {
+            batch.push_back(m_nodes.create(std::forward<decltype(value)>(value)));
+        }
+    }
+    catch (...) {
+        for (const auto node : batch) {
+            m_nodes.destroy(node);
+        }
+        throw;
+    }
+
+    const auto less = [this](details::NodeIndex a, details::NodeIndex b) {
+        return m_compare(traits::key(m_nodes[a].value()), traits::key(m_nodes[b].value()));
+    };
+    if (!std::is_sorted(batch.begin(), batch.end(), less)) {
+        details::parallel_sort(batch.begin(), batch.end(), less, threads);
+    }
+    m_mergeBatch(batch);
+}
+
+// rebuilding the whole tree does not pay off for a batch much smaller than the tree, it is inserted one by one then
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_mergeBatch(IndexVector & batch)
+{
+    if (batch.size() * std::bit_width(m_size) < m_size) {
+        for (const auto node : batch) {
+            const Position position = m_position(traits::key(m_nodes[node].value()));
+            if (position.m_found != details::null_node) {
+                m_nodes.destroy(node);
+            }
+            else {
+                m_attach(node, position);
+            }
+        }
+        return;
+    }
+
+    m_slots.clear();
+    m_flatten(m_root);
+    IndexVector merged(m_slots.get_allocator());
+    merged.reserve(m_slots.size() + batch.size());
+
+    const auto key = [this](details::NodeIndex node) -> const Key & { return traits::key(m_nodes[node].value()); };
+    auto tree_it = m_slots.begin();
+    for (const auto node : batch) {
+        while (tree_it != m_slots.end() && m_compare(key(*tree_it), key(node))) {
+            merged.push_back(*tree_it++);
+        }
+        const bool in_tree = tree_it != m_slots.end() && !m_compare(key(node), key(*tree_it));
+        const bool in_batch = !merged.empty() && !m_compare(key(merged.back()), key(node));
+        if (in_tree || in_batch) {
+            m_nodes.destroy(node);
+        }
+        else {
+            merged.push_back(node);
+        }
+    }
+    merged.insert(merged.end(), tree_it, m_slots.end());
+
+    m_slots.swap(merged);
+    m_root = m_insertMiddle(details::null_node, 0, m_slots.size());
+    m_size = m_maxSize = m_slots.size();
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::split(const key_type & key) -> BasicScapegoatTree
+{
+    BasicScapegoatTree greater(m_alpha, m_compare, m_nodes.get_allocator());
+    m_slots.clear();
+    m_flatten(m_root);
+    const auto middle = std::partition_point(m_slots.begin(), m_slots.end(), [&](details::NodeIndex node) {
+        return m_compare(traits::key(m_nodes[node].value()), key);
+    });
+
+    const auto take = [this](details::NodeIndex node) -> value_type && { return std::move(m_nodes[node].value()); };
+    greater.insert_bulk(std::ranges::subrange(middle, m_slots.end()) | std::views::transform(take));
+    for (auto it = middle; it != m_slots.end(); ++it) {
+        m_nodes.destroy(*it);
+    }
+    m_slots.erase(middle, m_slots.end());
+
+    m_root = m_insertMiddle(details::null_node, 0, m_slots.size());
+    m_size = m_maxSize = m_slots.size();
+    return greater;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::join(BasicScapegoatTree && other)
+{
+    if (other.empty()) {
+        return;
+    }
+    if (!empty() && !m_compare(traits::key(m_nodes[m_maxNode(m_root)].value()), traits::key(other.m_nodes[other.m_minNode(other.m_root)].value()))) {
+        throw std::invalid_argument("joined tree has to hold greater keys");
+    }
+
+    m_slots.clear();
+    m_flatten(m_root);
+    const std::size_t own = m_slots.size();
+    other.m_slots.clear();
+    other.m_flatten(other.m_root);
+    try {
+        for (const auto node : other.m_slots) {
+            m_slots.push_back(m_nodes.create(std::move(other.m_nodes[node].value())));
+        }
+    }
+    catch (...) {
+        for (std::size_t i = own; i < m_slots.size(); ++i) {
+            m_nodes.destroy(m_slots[i]);
+        }
+        throw;
+    }
+    other.clear();
+
+    m_root = m_insertMiddle(details::null_node, 0, m_slots.size());
+    m_size = m_maxSize = m_slots.size();
+}
+
+// 'operation' is one of std::set_* algorithms, it writes addresses of chosen elements
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class Operation>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_combine(const BasicScapegoatTree & a, const BasicScapegoatTree & b, std::size_t threads, Operation operation) -> BasicScapegoatTree
+{
+    using Chosen = std::vector<const value_type *>;
+    struct AddressInserter
+    {
+        Chosen * m_chosen;
+
+        AddressInserter & operator*()
+        {
+            return *this;
+        }
+        AddressInserter & operator++()
+        {
+            return *this;
+        }
+        AddressInserter operator++(int)
+        {
+            return *this;
+        }
+        AddressInserter & operator=(const value_type & value)
+        {
+            m_chosen->push_back(&value);
+            return *this;
+        }
+    };
+
+    const auto less = [&a](const value_type & x, const value_type & y) {
+        return a.m_compare(traits::key(x), traits::key(y));
+    };
+
+    // parts begin at elements of 'a' taken at equal steps
+    threads = std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(1, a.size()));
+    std::vector<const_iterator> a_bounds{a.begin()};
+    std::vector<const_iterator> b_bounds{b.begin()};
+    for (std::size_t i = 1; i < threads; ++i) {
+        a_bounds.push_back(a.select(a.size() * i / threads));
+        b_bounds.push_back(b.lower_bound(traits::key(*a_bounds.back())));
+    }
+    a_bounds.push_back(a.end());
+    b_bounds.push_back(b.end());
+
+    std::vector<Chosen> parts(threads);
+    const auto run = [&](std::size_t i) {
+        operation(a_bounds[i], a_bounds[i + 1], b_bounds[i], b_bounds[i + 1], AddressInserter{&parts[i]}, less);
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(run, i);
+    }
+    run(0);
+    for (auto & worker : workers) {
+        worker.join();
+    }
+
+    Chosen & chosen = parts.front();
+    for (std::size_t i = 1; i < threads; ++i) {
+        chosen.insert(chosen.end(), parts[i].begin(), parts[i].end());
+    }
+
+    BasicScapegoatTree result(a.m_alpha, a.m_compare, std::allocator_traits<Allocator>::select_on_container_copy_construction(a.m_nodes.get_allocator()));
+    const auto dereference = [](const value_type * value) -> const value_type & { return *value; };
+    result.insert_bulk(chosen | std::views::transform(dereference));
+    return result;
+}
+
+// find scapegoat node from start to root: the first with a child heavier than alpha of it,
+// a child of exactly alpha is still balanced (with alpha 0.5 a node and its only child would be picked again and again)
+template <class Key, class Mapped, class Compare, class Allocator>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_findScapegoat(details::NodeIndex start) const
+{
+    while (m_nodeSize(start) <= m_nodeSize(m_nodes[start].m_parent) * m_alpha) {
+        start = m_nodes[start].m_parent;
+    }
+    return m_nodes[start].m_parent;
+}
+
+// rebuild unbalanced subtree (scapegoat) by relinking its own nodes, nothing is allocated or moved
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_rebuildSubtree(details::NodeIndex scapegoat)
+{
+    details::NodeIndex parent = m_nodes[scapegoat].m_parent;
+    m_slots.clear();
+    m_flatten(scapegoat);
+    ++m_rebuilds;
+    m_rebuiltNodes += m_slots.size();
+
+    details::NodeIndex subtree = m_insertMiddle(parent, 0, m_slots.size());
+    if (parent == details::null_node) {
+        m_root = subtree;
+    }
+    else if (m_nodes[parent].m_left == scapegoat) {
+        m_nodes[parent].m_left = subtree;
+    }
+    else {
+        m_nodes[parent].m_right = subtree;
+    }
+}
+
+// fill m_slots with nodes of subtree (ptr) in order, walking successors up and down parent links
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_flatten(details::NodeIndex ptr)
+{
+    if (ptr == details::null_node) {
+        return;
+    }
+    std::size_t count = m_nodes[ptr].m_size;
+    ptr = m_minNode(ptr);
+    m_slots.push_back(ptr);
+    while (--count != 0) {
+        ptr = m_next(ptr);
+        m_slots.push_back(ptr);
+    }
+}
+
+// link m_slots[beg, end) into balanced subtree under parent
+// ranges still to link wait on a stack, there is at most one per level and a balanced tree of 32 bit indices is not deeper than 32
+template <class Key, class Mapped, class Compare, class Allocator>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_insertMiddle(details::NodeIndex parent, std::size_t beg, std::size_t end)
+{
+    struct Range
+    {
+        details::NodeIndex m_parent;
+        std::size_t m_beg;
+        std::size_t m_end;
+        bool m_is_right;
+    };
+    std::array<Range, 64> stack;
+    std::size_t top = 0;
+
+    // middle of the range becomes its root, halves are pushed
+    const auto link = [&](details::NodeIndex up, std::size_t lo, std::size_t hi) {
+        if (lo == hi) {
+            return details::null_node;
+        }
+        const std::size_t mid = lo + (hi - lo) / 2;
+        const details::NodeIndex ptr = m_slots[mid];
+        m_nodes[ptr].m_size = hi - lo;
+        m_nodes[ptr].m_parent = up;
+        stack[top++] = {ptr, mid + 1, hi, true};
+        stack[top++] = {ptr, lo, mid, false};
+        return ptr;
+    };
+
+    const details::NodeIndex root = link(parent, beg, end);
+    while (top != 0) {
+        const Range range = stack[--top];
+        const details::NodeIndex ptr = link(range.m_parent, range.m_beg, range.m_end);
+        (range.m_is_right ? m_nodes[range.m_parent].m_right : m_nodes[range.m_parent].m_left) = ptr;
+    }
+    return root;
+}
+
+// destroy values of subtree (ptr), slots go back to the pool
+// leaves are cut off one by one climbing back by parent links
+// only used before the whole pool is released, so nothing to do for trivial values
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_destroySubtree(details::NodeIndex ptr)
+{
+    if (std::is_trivially_destructible_v<value_type> || ptr == details::null_node) {
+        return;
+    }
+    const details::NodeIndex stop = m_nodes[ptr].m_parent;
+    while (ptr != stop) {
+        const auto & node = m_nodes[ptr];
+        if (node.m_left != details::null_node) {
+            ptr = node.m_left;
+        }
+        else if (node.m_right != details::null_node) {
+            ptr = node.m_right;
+        }
+        else {
+            const details::NodeIndex parent = node.m_parent;
+            if (parent != stop) {
+                (m_nodes[parent].m_left == ptr ? m_nodes[parent].m_left : m_nodes[parent].m_right) = details::null_node;
+            }
+            m_nodes.destroy(ptr);
+            ptr = parent;
+        }
+    }
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::at(const key_type & key) -> mapped_reference requires(!is_set)
+{
+    details::NodeIndex node = m_find(m_root, key);
+    if (node == details::null_node) {
+        throw std::out_of_range("key is not in the tree");
+    }
+    return m_nodes[node].value().second;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::at(const key_type & key) const -> const_mapped_reference requires(!is_set)
+{
+    details::NodeIndex node = m_find(m_root, key);
+    if (node == details::null_node) {
+        throw std::out_of_range("key is not in the tree");
+    }
+    return m_nodes[node].value().second;
+}
+
+// find node with key in subtree (start)
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class K>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_find(details::NodeIndex start, const K & key) const
+{
+    while (start != details::null_node) {
+        const auto & start_key = traits::key(m_nodes[start].value());
+        if (m_compare(start_key, key)) {
+            start = m_nodes[start].m_right;
+        }
+        else if (m_compare(key, start_key)) {
+            start = m_nodes[start].m_left;
+        }
+        else {
+            break;
+        }
+    }
+    return start;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class K>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_lowerBound(const K & key) const
+{
+    details::NodeIndex result = details::null_node;
+    for (details::NodeIndex ptr = m_root; ptr != details::null_node;) {
+        if (m_compare(traits::key(m_nodes[ptr].value()), key)) {
+            ptr = m_nodes[ptr].m_right;
+        }
+        else {
+            result = ptr;
+            ptr = m_nodes[ptr].m_left;
+        }
+    }
+    return result;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class K>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_upperBound(const K & key) const
+{
+    details::NodeIndex result = details::null_node;
+    for (details::NodeIndex ptr = m_root; ptr != details::null_node;) {
+        if (m_compare(key, traits::key(m_nodes[ptr].value()))) {
+            result = ptr;
+            ptr = m_nodes[ptr].m_left;
+        }
+        else {
+            ptr = m_nodes[ptr].m_right;
+        }
+    }
+    return result;
+}
+
+// sum sizes of left subtrees passed by while descending to key
+template <class Key, class Mapped, class Compare, class Allocator>
+template <class K>
+inline std::size_t BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_rank(const K & key) const
+{
+    std::size_t rank = 0;
+    for (details::NodeIndex ptr = m_root; ptr != details::null_node;) {
+        if (m_compare(traits::key(m_nodes[ptr].value()), key)) {
+            rank += m_nodeSize(m_nodes[ptr].m_left) + 1;
+            ptr = m_nodes[ptr].m_right;
+        }
+        else {
+            ptr = m_nodes[ptr].m_left;
+        }
+    }
+    return rank;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_select(std::size_t index) const
+{
+    if (index >= m_size) {
+        return details::null_node;
+    }
+    details::NodeIndex ptr = m_root;
+    while (true) {
+        const std::size_t left_size = m_nodeSize(m_nodes[ptr].m_left);
+        if (index < left_size) {
+            ptr = m_nodes[ptr].m_left;
+        }
+        else if (index == left_size) {
+            return ptr;
+        }
+        else {
+            index -= left_size + 1;
+            ptr = m_nodes[ptr].m_right;
+        }
+    }
+}
+
+// return index of the least node
+template <class Key, class Mapped, class Compare, class Allocator>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_minNode(details::NodeIndex ptr) const
+{
+    while (m_nodes[ptr].m_left != details::null_node) {
+        ptr = m_nodes[ptr].m_left;
+    }
+    return ptr;
+}
+
+// return index of the greatest node
+template <class Key, class Mapped, class Compare, class Allocator>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_maxNode(details::NodeIndex ptr) const
+{
+    while (m_nodes[ptr].m_right != details::null_node) {
+        ptr = m_nodes[ptr].m_right;
+    }
+    return ptr;
+}
+
+// in order successor, null_node after the greatest one
+template <class Key, class Mapped, class Compare, class Allocator>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_next(details::NodeIndex ptr) const
+{
+    if (m_nodes[ptr].m_right != details::null_node) {
+        return m_minNode(m_nodes[ptr].m_right);
+    }
+    details::NodeIndex parent = m_nodes[ptr].m_parent;
+    while (parent != details::null_node && m_nodes[parent].m_right == ptr) {
+        ptr = parent;
+        parent = m_nodes[ptr].m_parent;
+    }
+    return parent;
+}
+
+// in order predecessor, the greatest node before null_node (end)
+template <class Key, class Mapped, class Compare, class Allocator>
+inline details::NodeIndex BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_prev(details::NodeIndex ptr) const
+{
+    if (ptr == details::null_node) {
+        return m_maxNode(m_root);
+    }
+    if (m_nodes[ptr].m_left != details::null_node) {
+        return m_maxNode(m_nodes[ptr].m_left);
+    }
+    details::NodeIndex parent = m_nodes[ptr].m_parent;
+    while (parent != details::null_node && m_nodes[parent].m_left == ptr) {
+        ptr = parent;
+        parent = m_nodes[ptr].m_parent;
+    }
+    return parent;
+}
+
+// remove node with key
+template <class Key, class Mapped, class Compare, class Allocator>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::erase(const key_type & key) -> size_type
+{
+    details::NodeIndex node = m_find(m_root, key);
+    if (node == details::null_node) {
+        return 0;
+    }
+    m_erase(node);
+    return 1;
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline auto BasicScapegoatTree<Key, Mapped, Compare, Allocator>::erase(const_iterator pos) -> iterator
+{
+    details::NodeIndex next = m_next(pos.m_node);
+    m_erase(pos.m_node);
+    return iterator(this, next);
+}
+
+// unlink node, the whole tree is rebuilt once it shrank below alpha of its largest size
+// so removals keep depth logarithmic just like inserts do
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_erase(details::NodeIndex ptr)
+{
+    m_killKey(ptr);
+    --m_size;
+
+    if (m_root != details::null_node && m_size < m_alpha * m_maxSize) {
+        m_rebuildSubtree(m_root);
+        m_maxSize = m_size;
+    }
+}
+
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_killKey(details::NodeIndex ptr)
+{
+    auto & node = m_nodes[ptr];
+    const bool both_children = node.m_right != details::null_node && node.m_left != details::null_node;
+
+    // node leaving its place is the least one of right subtree if both children exist, it takes place of ptr
+    const details::NodeIndex moved = both_children ? m_minNode(node.m_right) : ptr;
+    for (details::NodeIndex i = m_nodes[moved].m_parent; i != details::null_node; i = m_nodes[i].m_parent) {
+        --m_nodes[i].m_size;
+    }
+
+    if (both_children) {
+        auto & successor = m_nodes[moved];
+        m_killKeyParentInit(successor.m_parent, moved, successor.m_right);
+
+        successor.m_left = node.m_left;
+        successor.m_right = node.m_right;
+        successor.m_size = node.m_size;
+        m_nodes[successor.m_left].m_parent = moved;
+        if (successor.m_right != details::null_node) {
+            m_nodes[successor.m_right].m_parent = moved;
+        }
+        m_killKeyParentInit(node.m_parent, ptr, moved);
+    }
+    else if (node.m_left != details::null_node) { // and m_right == null_node, only left exist
+        m_killKeyParentInit(node.m_parent, ptr, node.m_left);
+    }
+    else { // only right exist or none
+        m_killKeyParentInit(node.m_parent, ptr, node.m_right);
+    }
+
+    // delete only one node
+    m_nodes.destroy(ptr);
+}
+
+// initialisation of new parents of child of deleted value, child_ptr may be null_node
+template <class Key, class Mapped, class Compare, class Allocator>
+inline void BasicScapegoatTree<Key, Mapped, Compare, Allocator>::m_killKeyParentInit(details::NodeIndex parent, details::NodeIndex child, details::NodeIndex child_ptr)
+{
+    if (parent == details::null_node) {
+        m_root = child_ptr;
+    }
+    else if (m_nodes[parent].m_left == child) {
+        m_nodes[parent].m_left = child_ptr;
+    }
+    else {
+        m_nodes[parent].m_right = child_ptr;
+    }
+    if (child_ptr != details::null_node) {
+        m_nodes[child_ptr].m_parent = parent;
+    }
+}
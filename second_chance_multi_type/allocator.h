@@ -12,6 +12,11 @@ public:
     {
     }
 
+    // raw places, for PoolStdAllocator
+    using PoolAllocator::deallocate;
+    using PoolAllocator::owns;
+    using PoolAllocator::try_allocate;
+
     template <class T, class... Args>
     T * create(Args &&... args)
     {
@@ -0,0 +1,69 @@
+#include "cache.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Entry
+{
+    int data;
+    bool marked = false;
+
+    Entry(const int key)
+        : data(key)
+    {
+    }
+
+    bool operator==(const int other) const
+    {
+        return data == other;
+    }
+};
+
+using EntryCache = Cache<int, Entry, AllocatorWithPool>;
+
+// keys uniform over twice the capacity: about half of the gets miss and evict
+void BM_CacheGet(benchmark::State & state)
+{
+    const std::size_t capacity = state.range(0);
+    EntryCache cache(capacity, capacity * sizeof(Entry), std::initializer_list<std::size_t>{sizeof(Entry)});
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> uniform(0, 2 * capacity - 1);
+    std::vector<int> keys(1 << 16);
+    for (auto & key : keys) {
+        key = uniform(random);
+    }
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.get<Entry>(keys[i++ & (keys.size() - 1)]).data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// allocate and deallocate of one place in a half full pool
+void BM_PoolAllocate(benchmark::State & state)
+{
+    const std::size_t places = state.range(0);
+    PoolAllocator pool(places * sizeof(Entry), std::initializer_list<std::size_t>{sizeof(Entry)});
+    for (std::size_t i = 0; i < places / 2; ++i) {
+        pool.allocate(sizeof(Entry));
+    }
+    for (auto _ : state) {
+        void * ptr = pool.allocate(sizeof(Entry));
+        pool.deallocate(ptr);
+        benchmark::DoNotOptimize(ptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // anonymous namespace
+
+BENCHMARK(BM_CacheGet)->RangeMultiplier(16)->Range(16, 4096);
+BENCHMARK(BM_PoolAllocate)->RangeMultiplier(16)->Range(16, 4096);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,188 @@
+#include "allocator.h"
+#include "pool_std_allocator.h"
+
+#include "randomized_queue.h"
+#include "scapegoattree.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+// checks of PoolStdAllocator under std::vector, randomized_queue and ScapegoatTree, any failure aborts
+
+namespace {
+
+void check(bool condition, const char * what)
+{
+    if (!condition) {
+        std::cerr << "check failed: " << what << std::endl;
+        std::abort();
+    }
+}
+
+// PoolAllocator counting places it served and got back, to tell that containers really use it and return everything
+class CountingPool : public PoolAllocator
+{
+public:
+    using PoolAllocator::PoolAllocator;
+
+    void * try_allocate(const std::size_t size)
+    {
+        void * ptr = PoolAllocator::try_allocate(size);
+        m_served += ptr != nullptr;
+        return ptr;
+    }
+
+    void deallocate(const void * ptr)
+    {
+        m_returned += owns(ptr);
+        PoolAllocator::deallocate(ptr);
+    }
+
+    std::size_t served() const
+    {
+        return m_served;
+    }
+
+    std::size_t in_use() const
+    {
+        return m_served - m_returned;
+    }
+
+private:
+    std::size_t m_served = 0;
+    std::size_t m_returned = 0;
+};
+
+template <class T>
+using Allocator = PoolStdAllocator<T, CountingPool>;
+
+template <class T>
+bool is_aligned(const T * ptr)
+{
+    return reinterpret_cast<std::uintptr_t>(ptr) % alignof(T) == 0;
+}
+
+struct alignas(16) Wide
+{
+    std::uint64_t value;
+};
+
+// block sizes that are not multiples of alignments: only some places suit a type, the others are never handed out for it
+void check_alignment()
+{
+    CountingPool pool(100, {4, 8});
+    Allocator<double> doubles(pool);
+    std::vector<double *> taken;
+    for (int i = 0; i < 30; ++i) {
+        taken.push_back(doubles.allocate(1));
+        check(is_aligned(taken.back()), "double is aligned");
+        *taken.back() = i;
+    }
+    check(pool.served() > 0, "doubles come from the pool");
+    for (auto * ptr : taken) {
+        doubles.deallocate(ptr, 1);
+    }
+    check(pool.in_use() == 0, "doubles give their places back");
+
+    CountingPool wide_pool(1000, {16});
+    Allocator<Wide> wides(wide_pool);
+    std::vector<Wide *> wide_taken;
+    for (int i = 0; i < 200; ++i) {
+        wide_taken.push_back(wides.allocate(1));
+        check(is_aligned(wide_taken.back()), "over aligned type is aligned");
+    }
+    for (auto * ptr : wide_taken) {
+        wides.deallocate(ptr, 1);
+    }
+    check(wide_pool.in_use() == 0, "over aligned type gives its places back");
+
+    AllocatorWithPool with_pool(64, {sizeof(int)});
+    std::vector<int, PoolStdAllocator<int, AllocatorWithPool>> ints(PoolStdAllocator<int, AllocatorWithPool>{with_pool});
+    for (int i = 0; i < 100; ++i) {
+        ints.push_back(i);
+    }
+    check(ints.size() == 100 && ints[99] == 99, "vector over AllocatorWithPool");
+}
+
+void check_randomized_queue()
+{
+    CountingPool pool(1000, {8, 16, 24, 32, 48, 64, 128, 256});
+    {
+        randomized_queue<std::uint64_t, additionals::xoshiro256starstar, Allocator<std::uint64_t>> queue(1, Allocator<std::uint64_t>(pool));
+        for (std::uint64_t i = 0; i < 1000; ++i) {
+            queue.enqueue(i);
+        }
+        std::vector<std::uint64_t> out;
+        queue.sample_n(50, std::back_inserter(out));
+        check(out.size() == 50, "sample_n over the pool");
+        out.clear();
+        queue.dequeue_n(100, std::back_inserter(out));
+        while (!queue.empty()) {
+            out.push_back(queue.dequeue());
+        }
+        std::sort(out.begin(), out.end());
+        std::vector<std::uint64_t> expected(1000);
+        std::iota(expected.begin(), expected.end(), 0);
+        check(out == expected, "queue over the pool keeps every element once");
+
+        randomized_queue<Wide, additionals::xoshiro256starstar, Allocator<Wide>> wides(2, Allocator<Wide>(pool));
+        for (std::uint64_t i = 0; i < 10; ++i) {
+            wides.enqueue(Wide{i});
+            for (const auto & el : wides) {
+                check(is_aligned(&el), "queue of over aligned elements");
+            }
+        }
+    }
+    check(pool.served() > 0, "queue uses the pool");
+    check(pool.in_use() == 0, "queue gives its places back");
+}
+
+void check_scapegoat_tree()
+{
+    CountingPool pool(1000, {4, 8, 16, 24, 32, 64, 128, 256});
+    {
+        using Tree = ScapegoatTree<std::uint32_t, std::less<std::uint32_t>, Allocator<std::uint32_t>>;
+        Tree tree{Allocator<std::uint32_t>(pool)};
+        std::set<std::uint32_t> reference;
+        std::mt19937 random(3);
+        for (int i = 0; i < 20'000; ++i) {
+            const std::uint32_t key = random() % 2000;
+            if (random() % 3 == 0) {
+                check(tree.erase(key) == reference.erase(key), "erase over the pool");
+            }
+            else {
+                check(tree.insert(key).second == reference.insert(key).second, "insert over the pool");
+            }
+        }
+        check(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end()), "tree over the pool");
+
+        const Tree copy = tree;
+        Tree greater = tree.split(1000);
+        tree.join(std::move(greater));
+        check(std::equal(tree.begin(), tree.end(), copy.begin(), copy.end()), "copy, split and join over the pool");
+
+        const auto frozen = tree.freeze();
+        for (std::uint32_t key = 0; key < 2000; ++key) {
+            check(frozen.contains(key) == reference.contains(key), "frozen tree over the pool");
+        }
+    }
+    check(pool.served() > 0, "tree uses the pool");
+    check(pool.in_use() == 0, "tree gives its places back");
+}
+
+} // anonymous namespace
+
+int main()
+{
+    check_alignment();
+    check_randomized_queue();
+    check_scapegoat_tree();
+    std::cout << "pool allocator checks passed" << std::endl;
+}
@@ -20,6 +20,14 @@ std::size_t PoolAllocator::element_size(const std::size_t size_of_block) const
 }
 
 void * PoolAllocator::allocate(const std::size_t _element_size)
+{
+    if (void * ptr = try_allocate(_element_size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void * PoolAllocator::try_allocate(const std::size_t _element_size)
 {
     auto iter = std::lower_bound(
             m_used_map.begin(),
@@ -38,16 +46,24 @@ void * PoolAllocator::allocate(const std::size_t _element_size)
         }
         ++iter;
     }
-    throw std::bad_alloc{};
+    return nullptr;
 }
 
-void PoolAllocator::deallocate(const void * _ptr)
+bool PoolAllocator::owns(const void * _ptr) const
 {
     auto b_ptr = static_cast<const std::byte *>(_ptr);
     const auto begin = m_storage.data();
 
     std::less_equal<const std::byte *> cmp;
-    if (cmp(begin, b_ptr) && cmp(b_ptr, &m_storage.back())) {
+    return !m_storage.empty() && cmp(begin, b_ptr) && cmp(b_ptr, &m_storage.back());
+}
+
+void PoolAllocator::deallocate(const void * _ptr)
+{
+    auto b_ptr = static_cast<const std::byte *>(_ptr);
+    const auto begin = m_storage.data();
+
+    if (owns(_ptr)) {
         const std::size_t
                 offset = b_ptr - begin,
                 block_number = offset / m_block_size;
@@ -21,5 +21,9 @@ private:
 public:
     PoolAllocator(const std::size_t block_size, std::initializer_list<std::size_t> sizes);
     void * allocate(const std::size_t _vector);
+    // nullptr instead of std::bad_alloc when no block of that element size has a free place
+    void * try_allocate(const std::size_t _element_size);
     void deallocate(const void * _ptr);
+    // whether _ptr points into the pool's storage
+    bool owns(const void * _ptr) const;
 };
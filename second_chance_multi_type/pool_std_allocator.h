@@ -0,0 +1,86 @@
+#pragma once
+
+#include "pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+// standard allocator over a PoolAllocator (or AllocatorWithPool) for std containers, randomized_queue and ScapegoatTree:
+// requests of exactly a size class of the pool are served from its blocks, any other size, or when the blocks are full,
+// from operator new, deallocation tells them apart by address
+// a place lies at its block's offset (a multiple of the pool's block size) plus a multiple of its own size,
+// so it need not suit alignof(T): such places go back to the pool and operator new serves the request
+// copies and rebound copies share the pool, which has to outlive every container using it
+template <class T, class Pool = PoolAllocator>
+class PoolStdAllocator
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    // containers moved, swapped or copied keep using the pool they came with
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <class U>
+    struct rebind
+    {
+        using other = PoolStdAllocator<U, Pool>;
+    };
+
+    explicit PoolStdAllocator(Pool & pool) noexcept
+        : m_pool(&pool)
+    {
+    }
+
+    template <class U>
+    PoolStdAllocator(const PoolStdAllocator<U, Pool> & other) noexcept
+        : m_pool(other.pool())
+    {
+    }
+
+    T * allocate(std::size_t n)
+    {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length{};
+        }
+        if (void * ptr = m_pool->try_allocate(n * sizeof(T))) {
+            if (reinterpret_cast<std::uintptr_t>(ptr) % alignof(T) == 0) {
+                return static_cast<T *>(ptr);
+            }
+            m_pool->deallocate(ptr);
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    }
+
+    // sized: n is what allocate got
+    void deallocate(T * ptr, std::size_t n) noexcept
+    {
+        if (m_pool->owns(ptr)) {
+            m_pool->deallocate(ptr);
+        }
+        else {
+            ::operator delete(ptr, n * sizeof(T), std::align_val_t{alignof(T)});
+        }
+    }
+
+    Pool * pool() const noexcept
+    {
+        return m_pool;
+    }
+
+    template <class U>
+    friend bool operator==(const PoolStdAllocator & a, const PoolStdAllocator<U, Pool> & b) noexcept
+    {
+        return a.pool() == b.pool();
+    }
+
+private:
+    Pool * m_pool;
+};
@@ -0,0 +1,92 @@
+#include "wordnet.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// noun hierarchy of 'count' synsets "n<id>" under root n0, every synset has an earlier hypernym, some of them two
+WordNet make_wordnet(unsigned count)
+{
+    std::mt19937 random(42);
+    std::stringstream synsets;
+    std::stringstream hypernyms;
+    for (unsigned id = 0; id < count; ++id) {
+        synsets << id << ",n" << id << ",gloss of n" << id << "\n";
+        if (id == 0) {
+            continue;
+        }
+        hypernyms << id << "," << random() % id;
+        if (id > 1 && random() % 4 == 0) {
+            hypernyms << "," << random() % id;
+        }
+        hypernyms << "\n";
+    }
+    return WordNet(synsets, hypernyms);
+}
+
+// noun of synset 'id' in make_wordnet, appended rather than "n" + ... which GCC 12 flags with -Wrestrict
+std::string noun_name(unsigned id)
+{
+    std::string name = "n";
+    name += std::to_string(id);
+    return name;
+}
+
+std::vector<std::pair<std::string, std::string>> make_pairs(unsigned count)
+{
+    std::mt19937 random(7);
+    std::vector<std::pair<std::string, std::string>> pairs(1 << 12);
+    for (auto & [noun1, noun2] : pairs) {
+        noun1 = noun_name(random() % count);
+        noun2 = noun_name(random() % count);
+    }
+    return pairs;
+}
+
+void run_distance(benchmark::State & state, const WordNet & wordnet, unsigned count)
+{
+    const auto pairs = make_pairs(count);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const auto & [noun1, noun2] = pairs[i++ & (pairs.size() - 1)];
+        benchmark::DoNotOptimize(wordnet.distance(noun1, noun2));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// bidirectional search over the graph
+void BM_Distance(benchmark::State & state)
+{
+    const unsigned count = state.range(0);
+    WordNet wordnet = make_wordnet(count);
+    wordnet.set_cache_capacity(0);
+    run_distance(state, wordnet, count);
+}
+
+// lookup in the ancestor index of a mapped image
+void BM_DistanceImage(benchmark::State & state)
+{
+    const unsigned count = state.range(0);
+    const auto path = std::filesystem::temp_directory_path() / ("bench_wordnet_" + std::to_string(count) + ".img");
+    make_wordnet(count).save(path.string(), true);
+    {
+        WordNet wordnet = WordNet::load(path.string());
+        wordnet.set_cache_capacity(0);
+        run_distance(state, wordnet, count);
+    }
+    std::filesystem::remove(path);
+}
+
+} // anonymous namespace
+
+BENCHMARK(BM_Distance)->RangeMultiplier(16)->Range(1 << 10, 1 << 18);
+BENCHMARK(BM_DistanceImage)->RangeMultiplier(16)->Range(1 << 10, 1 << 18);
+
+BENCHMARK_MAIN();
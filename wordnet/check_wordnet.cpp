@@ -0,0 +1,311 @@
+#include "wordnet.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// checks of WordNet against a small hand built hierarchy, any failure aborts
+
+namespace {
+
+// entity - animal - dog (canine) - puppy
+//        \        \ cat
+//         \ plant - tree
+const char synsets_text[] =
+        "0,entity,that which exists\n"
+        "1,animal,living organism\n"
+        "2,plant,living organism without locomotion\n"
+        "3,dog canine,domestic animal\n"
+        "4,cat,feline\n"
+        "5,tree,woody plant\n"
+        "6,puppy,young dog\n";
+const char hypernyms_text[] =
+        "1,0\n"
+        "2,0\n"
+        "3,1\n"
+        "4,1\n"
+        "5,2\n"
+        "6,3\n";
+
+void check(bool condition, const char * what)
+{
+    if (!condition) {
+        std::cerr << "check failed: " << what << std::endl;
+        std::abort();
+    }
+}
+
+template <class Exception, class F>
+void check_throws(F && f, const char * what)
+{
+    try {
+        f();
+    }
+    catch (const Exception &) {
+        return;
+    }
+    check(false, what);
+}
+
+WordNet make_wordnet()
+{
+    std::istringstream synsets(synsets_text);
+    std::istringstream hypernyms(hypernyms_text);
+    return WordNet(synsets, hypernyms);
+}
+
+std::vector<std::string> all_nouns(const WordNet & wordnet)
+{
+    const auto nouns = wordnet.nouns();
+    return {nouns.begin(), nouns.end()};
+}
+
+// same nouns and the same distance and sca of every pair
+bool same_answers(const WordNet & a, const WordNet & b)
+{
+    const auto nouns = all_nouns(a);
+    if (nouns != all_nouns(b)) {
+        return false;
+    }
+    for (const auto & noun1 : nouns) {
+        for (const auto & noun2 : nouns) {
+            if (a.distance(noun1, noun2) != b.distance(noun1, noun2) || a.sca(noun1, noun2) != b.sca(noun1, noun2)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// image files in the temporary directory, removed on exit
+class TemporaryPath
+{
+public:
+    explicit TemporaryPath(const std::string & name)
+        : m_path((std::filesystem::temp_directory_path() / ("check_wordnet_" + name)).string())
+    {
+    }
+
+    ~TemporaryPath()
+    {
+        std::error_code error;
+        std::filesystem::remove(m_path, error);
+    }
+
+    const std::string & str() const
+    {
+        return m_path;
+    }
+
+private:
+    std::string m_path;
+};
+
+void overwrite(const std::string & path, std::streamoff offset, const void * data, std::size_t size)
+{
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(offset);
+    file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    check(static_cast<bool>(file), "patching image");
+}
+
+void check_queries()
+{
+    const WordNet wordnet = make_wordnet();
+    check(all_nouns(wordnet).size() == 8, "nouns");
+    check(wordnet.is_noun("canine") && !wordnet.is_noun("wolf"), "is_noun");
+    check(wordnet.distance("dog", "cat") == 2, "distance of siblings");
+    check(wordnet.distance("puppy", "tree") == 5, "distance over the root");
+    check(wordnet.distance("canine", "dog") == 0, "distance of synonyms");
+    check(wordnet.sca("puppy", "cat") == "living organism", "sca");
+    check_throws<std::out_of_range>([&] { wordnet.distance("dog", "wolf"); }, "distance of unknown noun");
+
+    Outcast outcast(wordnet);
+    check(outcast.outcast({"dog", "cat", "puppy", "tree"}) == "tree", "outcast");
+    check(outcast.outcast({"dog", "cat"}).empty(), "outcast of a tie");
+}
+
+void check_image()
+{
+    const WordNet wordnet = make_wordnet();
+    for (const bool with_ancestors : {false, true}) {
+        const TemporaryPath path(with_ancestors ? "ancestors.img" : "plain.img");
+        wordnet.save(path.str(), with_ancestors);
+        check(same_answers(wordnet, WordNet::load(path.str())), "image round trip");
+    }
+
+    // a damaged image is rejected by its checksum, a newer format by its version
+    const TemporaryPath path("damaged.img");
+    wordnet.save(path.str());
+    const auto size = std::filesystem::file_size(path.str());
+    const char flipped = '\xff';
+    overwrite(path.str(), static_cast<std::streamoff>(size - 1), &flipped, 1);
+    check_throws<std::runtime_error>([&] { WordNet::load(path.str()); }, "checksum mismatch");
+
+    wordnet.save(path.str());
+    const std::uint32_t version = details::ImageHeader::current_version + 1;
+    overwrite(path.str(), offsetof(details::ImageHeader, m_version), &version, sizeof(version));
+    check_throws<std::runtime_error>([&] { WordNet::load(path.str(), false); }, "unsupported version");
+    check_throws<std::runtime_error>([&] { WordNet::load(path.str() + ".missing"); }, "missing image");
+}
+
+// nearest nouns agree with distance, come nearest first and cover every other noun
+void check_nearest(const WordNet & wordnet)
+{
+    const auto nouns = all_nouns(wordnet);
+    for (const auto & noun : nouns) {
+        const auto nearest = wordnet.nearest(noun, nouns.size());
+        check(nearest.size() == nouns.size() - 1, "nearest covers every other noun");
+        std::set<std::string> found;
+        unsigned previous = 0;
+        for (const auto & [other, dist] : nearest) {
+            check(other != noun && found.insert(other).second, "nearest lists every noun once");
+            check(dist == wordnet.distance(noun, other), "nearest distance");
+            check(previous <= dist, "nearest order");
+            previous = dist;
+        }
+        const auto first = wordnet.nearest(noun, 2);
+        check(std::equal(first.begin(), first.end(), nearest.begin()), "first of nearest");
+    }
+    check(wordnet.nearest("dog", 1) == std::vector<std::pair<std::string, unsigned>>{{"canine", 0}}, "synonym is nearest");
+    check(wordnet.nearest("dog", 0).empty(), "no nearest");
+}
+
+// a failing batch changes nothing, a good one applies over a mapped image as well
+void check_update()
+{
+    WordNet wordnet = make_wordnet();
+    WordNet::Batch broken;
+    broken.add_synset(7, {"wolf"}, "wild dog");
+    broken.add_hypernym(7, 3);
+    broken.add_hypernym(7, 42);
+    check_throws<std::invalid_argument>([&] { wordnet.update(broken); }, "edge to unknown synset");
+    check(!wordnet.is_noun("wolf") && all_nouns(wordnet).size() == 8, "failed batch applied nothing");
+
+    WordNet::Batch duplicate;
+    duplicate.add_synset(7, {"wolf"}, "wild dog");
+    duplicate.add_synset(4, {"kitten"}, "young cat");
+    check_throws<std::invalid_argument>([&] { wordnet.update(duplicate); }, "synset added twice");
+    check(!wordnet.is_noun("wolf") && !wordnet.is_noun("kitten"), "failed batch applied nothing");
+
+    const TemporaryPath path("updated.img");
+    wordnet.save(path.str(), true);
+    WordNet mapped = WordNet::load(path.str());
+    for (WordNet * target : {&wordnet, &mapped}) {
+        WordNet::Batch batch;
+        batch.add_synset(7, {"wolf"}, "wild dog");
+        batch.add_hypernym(7, 3);
+        batch.add_hypernym(5, 4); // new edge between synsets of the image
+        target->update(batch);
+        check(target->distance("wolf", "puppy") == 2 && target->distance("tree", "cat") == 1, "update");
+        check_nearest(*target);
+    }
+    mapped.save(path.str(), true);
+    check(same_answers(wordnet, WordNet::load(path.str())), "image of updated WordNet");
+}
+
+// readers see every batch whole or not at all, while a writer keeps publishing
+void check_snapshots()
+{
+    WordNet wordnet = make_wordnet();
+    constexpr unsigned batches = 200;
+    std::atomic<bool> done = false;
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                std::size_t first = 0;
+                std::size_t second = 0;
+                for (const auto & noun : wordnet.nouns()) {
+                    first += noun.starts_with("first");
+                    second += noun.starts_with("second");
+                }
+                check(first == second, "batch seen in part");
+                check(wordnet.distance("dog", "cat") == 2, "distance during updates");
+            }
+        });
+    }
+    for (unsigned i = 0; i < batches; ++i) {
+        WordNet::Batch batch;
+        const unsigned id = 7 + 2 * i;
+        batch.add_synset(id, {"first" + std::to_string(i)}, "generated");
+        batch.add_synset(id + 1, {"second" + std::to_string(i)}, "generated");
+        batch.add_hypernym(id, 0);
+        batch.add_hypernym(id + 1, id);
+        wordnet.update(batch);
+    }
+    done = true;
+    for (auto & reader : readers) {
+        reader.join();
+    }
+    check(all_nouns(wordnet).size() == 8 + 2 * batches, "all batches applied");
+    check(wordnet.distance("first0", "second199") == 3, "distance over added synsets");
+}
+
+// the cache keeps no more pairs than its capacity, and the last ones put in
+void check_cache()
+{
+    for (const std::size_t capacity : {1, 5, 16, 100}) {
+        QueryCache cache(capacity);
+        for (unsigned noun = 0; noun < 1000; ++noun) {
+            cache.put(noun, noun + 1, {noun, 1});
+        }
+        std::size_t kept = 0;
+        for (unsigned noun = 0; noun < 1000; ++noun) {
+            kept += cache.get(noun, noun + 1).has_value();
+        }
+        check(kept <= capacity, "cache capacity");
+        check(cache.get(1000, 999) == QueryCache::Result{999, 1}, "last pair in cache");
+    }
+
+    WordNet wordnet = make_wordnet();
+    wordnet.set_cache_capacity(2);
+    wordnet.distance("dog", "cat");
+    wordnet.distance("cat", "dog");
+    check(wordnet.cache_stats().hits == 1 && wordnet.distance("dog", "cat") == 2, "cached distance");
+}
+
+// an image saved over a mapped one leaves the mapping intact
+void check_replaced_image()
+{
+    const TemporaryPath path("replaced.img");
+    const WordNet wordnet = make_wordnet();
+    wordnet.save(path.str(), true);
+    const WordNet mapped = WordNet::load(path.str());
+
+    WordNet bigger = make_wordnet();
+    WordNet::Batch batch;
+    for (unsigned id = 7; id < 1000; ++id) {
+        batch.add_synset(id, {"noun" + std::to_string(id)}, "generated");
+        batch.add_hypernym(id, id - 1);
+    }
+    bigger.update(batch);
+    bigger.save(path.str(), true);
+    check(same_answers(wordnet, mapped), "mapped image after it was replaced");
+    check(WordNet::load(path.str()).is_noun("noun999"), "replacing image");
+}
+
+} // anonymous namespace
+
+int main()
+{
+    check_queries();
+    check_nearest(make_wordnet());
+    check_image();
+    check_cache();
+    check_update();
+    check_snapshots();
+    check_replaced_image();
+    std::cout << "wordnet checks passed" << std::endl;
+}
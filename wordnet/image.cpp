@@ -0,0 +1,178 @@
+#include "image.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define WORDNET_IMAGE_MMAP
+#endif
+
+namespace details {
+
+namespace {
+
+constexpr std::size_t alignment = 8;
+
+std::size_t align_up(std::size_t value)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // anonymous namespace
+
+// Image section
+Image::Image(std::vector<std::byte> && buffer)
+{
+    auto owner = std::make_shared<const std::vector<std::byte>>(std::move(buffer));
+    *this = Image(owner, owner->data(), owner->size());
+    validate(false);
+}
+
+Image::Image(std::shared_ptr<const void> owner, const std::byte * data, std::size_t size)
+    : m_owner(std::move(owner))
+    , m_data(data)
+    , m_size(size)
+{
+}
+
+Image Image::map_file(const std::string & path, bool verify_checksum)
+{
+#ifdef WORDNET_IMAGE_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open wordnet image " + path);
+    }
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ImageHeader))) {
+        close(fd);
+        throw std::runtime_error("wordnet image " + path + " is truncated");
+    }
+    const auto size = static_cast<std::size_t>(info.st_size);
+    void * address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("cannot map wordnet image " + path);
+    }
+    std::shared_ptr<const void> mapping(address, [size](const void * ptr) {
+        munmap(const_cast<void *>(ptr), size);
+    });
+    Image image(mapping, static_cast<const std::byte *>(address), size);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("cannot open wordnet image " + path);
+    }
+    std::vector<char> raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto buffer = std::make_shared<std::vector<std::byte>>(raw.size());
+    std::memcpy(buffer->data(), raw.data(), raw.size());
+    Image image(buffer, buffer->data(), buffer->size());
+#endif
+    image.validate(verify_checksum);
+    return image;
+}
+
+std::span<const std::byte> Image::bytes() const
+{
+    return {m_data, m_size};
+}
+
+// written next to the target and renamed over it: processes which have the old image mapped keep its inode,
+// truncating it in place would fault their next read
+void Image::save(const std::string & path) const
+{
+    const std::string temporary = path + ".tmp" + std::to_string(std::random_device{}());
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(m_data), static_cast<std::streamsize>(m_size));
+    file.close();
+    std::error_code error;
+    if (file) {
+        std::filesystem::rename(temporary, path, error);
+    }
+    if (!file || error) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("cannot write wordnet image " + path);
+    }
+}
+
+const ImageHeader & Image::header() const
+{
+    return *reinterpret_cast<const ImageHeader *>(m_data);
+}
+
+void Image::validate(bool verify_checksum) const
+{
+    if (m_size < sizeof(ImageHeader) || reinterpret_cast<std::uintptr_t>(m_data) % alignment != 0) {
+        throw std::runtime_error("wordnet image is truncated");
+    }
+    const ImageHeader & head = header();
+    if (std::memcmp(head.m_magic, ImageHeader::magic, sizeof(ImageHeader::magic)) != 0) {
+        throw std::runtime_error("not a wordnet image");
+    }
+    if (head.m_version != ImageHeader::current_version || head.m_byte_order != ImageHeader::byte_order_mark) {
+        throw std::runtime_error("wordnet image format is not supported, rebuild it");
+    }
+    if (head.m_size != m_size) {
+        throw std::runtime_error("wordnet image is truncated");
+    }
+    for (const auto & entry : head.m_sections) {
+        if (entry.m_offset % alignment != 0 || entry.m_offset < sizeof(ImageHeader) ||
+            entry.m_offset > m_size || entry.m_size > m_size - entry.m_offset) {
+            throw std::runtime_error("wordnet image is damaged");
+        }
+    }
+    if (verify_checksum && head.m_checksum != checksum(bytes().subspan(sizeof(ImageHeader)))) {
+        throw std::runtime_error("wordnet image checksum mismatch");
+    }
+}
+
+// ImageWriter section
+void ImageWriter::set_bytes(Section section, std::span<const std::byte> data)
+{
+    m_sections[static_cast<std::size_t>(section)].assign(data.begin(), data.end());
+}
+
+std::vector<std::byte> ImageWriter::finish() &&
+{
+    ImageHeader head{};
+    std::memcpy(head.m_magic, ImageHeader::magic, sizeof(ImageHeader::magic));
+    head.m_version = ImageHeader::current_version;
+    head.m_byte_order = ImageHeader::byte_order_mark;
+
+    std::size_t size = align_up(sizeof(ImageHeader));
+    for (std::size_t i = 0; i < std::size(m_sections); ++i) {
+        head.m_sections[i] = {size, m_sections[i].size()};
+        size = align_up(size + m_sections[i].size());
+    }
+    head.m_size = size;
+
+    std::vector<std::byte> buffer(size);
+    for (std::size_t i = 0; i < std::size(m_sections); ++i) {
+        if (!m_sections[i].empty()) {
+            std::memcpy(buffer.data() + head.m_sections[i].m_offset, m_sections[i].data(), m_sections[i].size());
+        }
+    }
+    head.m_checksum = checksum(std::span<const std::byte>(buffer).subspan(sizeof(ImageHeader)));
+    std::memcpy(buffer.data(), &head, sizeof(head));
+    return buffer;
+}
+
+std::uint64_t checksum(std::span<const std::byte> data)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const auto byte : data) {
+        hash ^= static_cast<std::uint64_t>(byte);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace details
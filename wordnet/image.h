@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace details {
+
+// nouns are front coded in blocks of this size, first noun of a block is stored whole
+constexpr std::size_t noun_block_size = 16;
+
+// sections of a prebuilt WordNet image
+// vertices are synsets renumbered densely in order of ascending synset id,
+// nouns are sorted lexicographically, every "offsets" section holds count + 1 bounds
+enum class Section : std::uint32_t
+{
+    SynsetIds,         // std::uint32_t synset id of every vertex
+    GlossOffsets,      // bounds of vertex gloss in GlossArena
+    GlossArena,        // char
+    EdgeOffsets,       // bounds of vertex hypernyms in Edges
+    Edges,             // std::uint32_t vertex of hypernym
+    ReverseOffsets,    // bounds of vertex hyponyms in ReverseEdges
+    ReverseEdges,      // std::uint32_t vertex of hyponym
+    NounBlocks,        // bounds of every noun block in NounArena
+    NounArena,         // varint lengths (shared prefix, suffix) followed by suffix chars
+    NounSynsetOffsets, // bounds of noun synsets in NounSynsets
+    NounSynsets,       // std::uint32_t vertex
+    SynsetNounOffsets, // bounds of vertex synonyms in SynsetNouns
+    SynsetNouns,       // std::uint32_t noun
+    AncestorOffsets,   // bounds of vertex ancestors in Ancestors, empty without ancestor index
+    Ancestors,         // AncestorEntry sorted by vertex
+    Count
+};
+
+struct AncestorEntry
+{
+    std::uint32_t m_vertex;
+    std::uint32_t m_distance;
+};
+
+struct SectionEntry
+{
+    std::uint64_t m_offset; // from the beginning of the image
+    std::uint64_t m_size;   // in bytes
+};
+
+struct ImageHeader
+{
+    static constexpr char magic[8] = {'W', 'N', 'I', 'M', 'A', 'G', 'E', '\0'};
+    static constexpr std::uint32_t current_version = 3;
+    static constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+    char m_magic[8];
+    std::uint32_t m_version;
+    std::uint32_t m_byte_order;
+    std::uint64_t m_size;     // of the whole image
+    std::uint64_t m_checksum; // FNV-1a of everything after the header
+    SectionEntry m_sections[static_cast<std::size_t>(Section::Count)];
+};
+
+// read-only view of an image, either owned in memory or mapped from a file
+// copies share the same storage
+class Image
+{
+public:
+    Image() = default;
+
+    // takes ownership of a buffer produced by ImageWriter
+    explicit Image(std::vector<std::byte> && buffer);
+
+    // maps image file into memory, throws std::runtime_error if it is not a valid image
+    static Image map_file(const std::string & path, bool verify_checksum = true);
+
+    template <class T>
+    std::span<const T> section(Section section) const
+    {
+        const SectionEntry & entry = header().m_sections[static_cast<std::size_t>(section)];
+        return {reinterpret_cast<const T *>(m_data + entry.m_offset), entry.m_size / sizeof(T)};
+    }
+
+    std::span<const std::byte> bytes() const;
+
+    void save(const std::string & path) const;
+
+private:
+    std::shared_ptr<const void> m_owner;
+    const std::byte * m_data = nullptr;
+    std::size_t m_size = 0;
+
+    Image(std::shared_ptr<const void> owner, const std::byte * data, std::size_t size);
+
+    const ImageHeader & header() const;
+
+    // throws std::runtime_error on a stale or damaged image
+    void validate(bool verify_checksum) const;
+};
+
+// lays sections out one after another (8 bytes aligned) behind the header
+class ImageWriter
+{
+public:
+    template <class T>
+    void set(Section section, std::span<const T> data)
+    {
+        set_bytes(section, std::as_bytes(data));
+    }
+
+    template <class T>
+    void set(Section section, const std::vector<T> & data)
+    {
+        set(section, std::span<const T>(data));
+    }
+
+    std::vector<std::byte> finish() &&;
+
+private:
+    std::vector<std::byte> m_sections[static_cast<std::size_t>(Section::Count)];
+
+    void set_bytes(Section section, std::span<const std::byte> data);
+};
+
+std::uint64_t checksum(std::span<const std::byte> data);
+
+} // namespace details
@@ -1,9 +1,206 @@
 #include "wordnet.h"
 
-// Wordnet section
-WordNet::WordNet(std::istream & synsets, std::istream & hypernyms)
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+
+static_assert(sizeof(unsigned) == sizeof(std::uint32_t), "image stores vertices as 32 bit numbers");
+
+using SynsetMap = std::map<unsigned, std::pair<std::vector<std::string>, std::string>>;
+using EdgeMap = std::map<unsigned, std::vector<unsigned>>;
+
+// append 'value' to 'arena' and close its bounds in 'offsets'
+template <class Arena, class Range>
+void append_bounded(std::vector<unsigned> & offsets, Arena & arena, const Range & value)
+{
+    arena.insert(arena.end(), value.begin(), value.end());
+    offsets.push_back(arena.size());
+}
+
+void put_varint(std::vector<char> & arena, std::size_t value)
+{
+    while (value >= 0x80) {
+        arena.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    arena.push_back(static_cast<char>(value));
+}
+
+std::size_t get_varint(std::span<const char> arena, std::size_t & position)
+{
+    std::size_t value = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        const auto byte = static_cast<unsigned char>(arena[position++]);
+        value |= static_cast<std::size_t>(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+// front coded noun: length of prefix shared with the previous noun of the block and the rest of it
+struct NounEntry
+{
+    std::size_t m_prefix;
+    std::string_view m_suffix;
+};
+
+NounEntry get_noun(std::span<const char> arena, std::size_t & position)
+{
+    const std::size_t prefix = get_varint(arena, position);
+    const std::size_t length = get_varint(arena, position);
+    const std::string_view suffix(arena.data() + position, length);
+    position += length;
+    return {prefix, suffix};
+}
+
+// lay out parsed synsets and hypernyms as image sections
+details::Image compile(const SynsetMap & synset_map, const EdgeMap & edge_map)
+{
+    std::vector<unsigned> ids;
+    for (const auto & [id, synset] : synset_map) {
+        ids.push_back(id);
+    }
+    for (const auto & [id, hypernyms] : edge_map) {
+        ids.push_back(id);
+        ids.insert(ids.end(), hypernyms.begin(), hypernyms.end());
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::unordered_map<unsigned, unsigned> vertex_of;
+    for (unsigned vertex = 0; vertex < ids.size(); ++vertex) {
+        vertex_of.emplace(ids[vertex], vertex);
+    }
+
+    std::map<std::string, std::vector<unsigned>> wordmap;
+    std::vector<unsigned> gloss_offsets{0}, edge_offsets{0};
+    std::vector<char> gloss_arena;
+    std::vector<unsigned> edges;
+    for (const auto id : ids) {
+        const auto synset = synset_map.find(id);
+        if (synset != synset_map.end()) {
+            append_bounded(gloss_offsets, gloss_arena, synset->second.second);
+            for (const auto & word : synset->second.first) {
+                wordmap[word].push_back(vertex_of.at(id));
+            }
+        }
+        else {
+            gloss_offsets.push_back(gloss_arena.size());
+        }
+
+        std::vector<unsigned> hypernyms;
+        const auto hypernym_ids = edge_map.find(id);
+        if (hypernym_ids != edge_map.end()) {
+            for (const auto hypernym : hypernym_ids->second) {
+                hypernyms.push_back(vertex_of.at(hypernym));
+            }
+        }
+        append_bounded(edge_offsets, edges, hypernyms);
+    }
+
+    std::vector<std::vector<unsigned>> hyponyms(ids.size());
+    for (unsigned vertex = 0; vertex < ids.size(); ++vertex) {
+        for (unsigned i = edge_offsets[vertex]; i < edge_offsets[vertex + 1]; ++i) {
+            hyponyms[edges[i]].push_back(vertex);
+        }
+    }
+    std::vector<unsigned> reverse_offsets{0}, reverse_edges;
+    for (const auto & vertices : hyponyms) {
+        append_bounded(reverse_offsets, reverse_edges, vertices);
+    }
+
+    std::vector<unsigned> noun_blocks{0}, noun_synset_offsets{0};
+    std::vector<char> noun_arena;
+    std::vector<unsigned> noun_synsets;
+    std::vector<std::vector<unsigned>> synonyms(ids.size());
+    std::string_view previous;
+    for (const auto & [word, vertices] : wordmap) {
+        const unsigned index = noun_synset_offsets.size() - 1;
+        for (const auto vertex : vertices) {
+            synonyms[vertex].push_back(index);
+        }
+        append_bounded(noun_synset_offsets, noun_synsets, vertices);
+
+        std::size_t prefix = 0;
+        if (index % details::noun_block_size != 0) {
+            prefix = std::mismatch(previous.begin(), previous.end(), word.begin(), word.end()).first - previous.begin();
+        }
+        put_varint(noun_arena, prefix);
+        put_varint(noun_arena, word.size() - prefix);
+        noun_arena.insert(noun_arena.end(), word.begin() + prefix, word.end());
+        if ((index + 1) % details::noun_block_size == 0 || index + 1 == wordmap.size()) {
+            noun_blocks.push_back(noun_arena.size());
+        }
+        previous = word;
+    }
+    std::vector<unsigned> synset_noun_offsets{0}, synset_nouns;
+    for (const auto & words : synonyms) {
+        append_bounded(synset_noun_offsets, synset_nouns, words);
+    }
+
+    details::ImageWriter writer;
+    writer.set(details::Section::SynsetIds, ids);
+    writer.set(details::Section::GlossOffsets, gloss_offsets);
+    writer.set(details::Section::GlossArena, gloss_arena);
+    writer.set(details::Section::EdgeOffsets, edge_offsets);
+    writer.set(details::Section::Edges, edges);
+    writer.set(details::Section::ReverseOffsets, reverse_offsets);
+    writer.set(details::Section::ReverseEdges, reverse_edges);
+    writer.set(details::Section::NounBlocks, noun_blocks);
+    writer.set(details::Section::NounArena, noun_arena);
+    writer.set(details::Section::NounSynsetOffsets, noun_synset_offsets);
+    writer.set(details::Section::NounSynsets, noun_synsets);
+    writer.set(details::Section::SynsetNounOffsets, synset_noun_offsets);
+    writer.set(details::Section::SynsetNouns, synset_nouns);
+    return details::Image(std::move(writer).finish());
+}
+
+// every vertex with all of its ancestors (itself included) sorted by vertex
+void compile_ancestors(details::ImageWriter & writer, const Digraph & graph)
+{
+    std::vector<unsigned> offsets{0};
+    std::vector<details::AncestorEntry> ancestors;
+    std::vector<unsigned> distance(graph.size(), static_cast<unsigned>(-1));
+    std::vector<unsigned> ids;
+    for (unsigned vertex = 0; vertex < graph.size(); ++vertex) {
+        ids.assign(1, vertex);
+        distance[vertex] = 0;
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            for (const auto id_h : graph.get(ids[i])) {
+                if (distance[id_h] == static_cast<unsigned>(-1)) {
+                    distance[id_h] = distance[ids[i]] + 1;
+                    ids.push_back(id_h);
+                }
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+        for (const auto id : ids) {
+            ancestors.push_back({id, distance[id]});
+            distance[id] = static_cast<unsigned>(-1);
+        }
+        offsets.push_back(ancestors.size());
+    }
+    writer.set(details::Section::AncestorOffsets, offsets);
+    writer.set(details::Section::Ancestors, ancestors);
+}
+
+Digraph image_graph(const details::Image & image)
+{
+    return Digraph(image.section<unsigned>(details::Section::EdgeOffsets),
+                   image.section<unsigned>(details::Section::Edges),
+                   image.section<unsigned>(details::Section::ReverseOffsets),
+                   image.section<unsigned>(details::Section::ReverseEdges));
+}
+
+details::Image parse(std::istream & synsets, std::istream & hypernyms)
 {
-    Digraph dgrth;
+    SynsetMap synset_map;
+    EdgeMap edge_map;
     std::string line;
     while (std::getline(synsets, line)) {
         std::string token;
@@ -21,77 +218,549 @@ WordNet::WordNet(std::istream & synsets, std::istream & hypernyms)
         std::string token1;
         while (std::getline(synonyms_stream, token1, ' ')) {
             synonyms.push_back(token1);
-            if (m_wordmap.find(token1) == m_wordmap.end()) {
-                m_wordmap.insert({token1, {id}});
-            }
-            else {
-                m_wordmap.at(token1).push_back(id);
-            }
         }
         // gloss
         std::getline(line_stream, token, ',');
 
-        std::pair<std::vector<std::string>, std::string> tmp_pair;
-        tmp_pair.first = synonyms;
-        tmp_pair.second = token;
-        m_synset_map.emplace(id, std::move(tmp_pair));
+        synset_map.emplace(id, std::make_pair(std::move(synonyms), std::move(token)));
     }
     while (std::getline(hypernyms, line)) {
         std::string token;
-        unsigned id;
-        std::vector<unsigned> hypernym_list;
         std::stringstream line_stream(line);
         // id
         std::getline(line_stream, token, ',');
         if (token.empty()) {
             continue;
         }
-        id = std::stoul(token);
+        const unsigned id = std::stoul(token);
         // hypernyms
+        std::vector<unsigned> & hypernym_list = edge_map[id];
         while (std::getline(line_stream, token, ',')) {
-            unsigned hypernym = std::stoul(token);
-            dgrth.push(id, hypernym);
-            hypernym_list.push_back(hypernym);
+            hypernym_list.push_back(std::stoul(token));
+        }
+    }
+    return compile(synset_map, edge_map);
+}
+
+} // anonymous namespace
+
+// Snapshot section
+struct WordNet::Snapshot
+{
+    details::Image m_image;
+    std::span<const unsigned> m_synset_ids;
+    std::span<const unsigned> m_noun_blocks;
+    std::span<const char> m_noun_arena;
+    std::span<const unsigned> m_noun_synset_offsets;
+    std::span<const unsigned> m_noun_synsets;
+    std::span<const unsigned> m_gloss_offsets;
+    std::span<const char> m_gloss_arena;
+    std::span<const unsigned> m_synset_noun_offsets;
+    std::span<const unsigned> m_synset_nouns;
+    ShortestCommonAncestor m_commanc;
+    std::shared_ptr<QueryCache> m_cache;
+
+    // changes made by 'update' over the image, nouns and vertices added are numbered after the image ones
+    std::unordered_map<std::string, unsigned> m_wordmap;                                     // added noun -> noun id
+    std::vector<std::string> m_added_nouns;                                                  // by noun id
+    std::unordered_map<unsigned, std::vector<unsigned>> m_noun_synsets_patch;                // noun id -> all its synsets
+    std::unordered_map<unsigned, std::pair<std::vector<std::string>, std::string>> m_synset_map; // added vertex -> synset
+    std::unordered_map<unsigned, unsigned> m_vertex_of;                                      // added synset id -> vertex
+    std::vector<unsigned> m_added_ids;                                                       // synset id of added vertex
+
+    explicit Snapshot(details::Image && image);
+
+    bool is_patched() const;
+    // image with all of the changes
+    details::Image rebuild() const;
+
+    void add_synset(unsigned id, const std::vector<std::string> & synonyms, const std::string & gloss);
+    void add_hypernym(unsigned id, unsigned hypernym_id);
+
+    std::size_t image_noun_count() const;
+    std::size_t noun_count() const;
+    std::optional<unsigned> find_image_noun(std::string_view word) const;
+    std::optional<unsigned> find_noun(std::string_view word) const;
+    std::string noun(unsigned noun_id) const;
+    // throws std::out_of_range if noun is not stored in WordNet
+    unsigned get_noun_id(const std::string & noun) const;
+    std::span<const unsigned> get_set_id(unsigned noun_id) const;
+
+    std::optional<unsigned> find_vertex(unsigned id) const;
+    unsigned synset_id(unsigned vertex) const;
+    std::string_view gloss(unsigned vertex) const;
+
+    // ancestor and length of the pair, served from cache when possible
+    QueryCache::Result search(const std::string & noun1, const std::string & noun2) const;
+
+    // calls 'visit' with id of every noun of vertex
+    template <class Visit>
+    void for_each_synonym(unsigned vertex, Visit && visit) const;
+};
+
+WordNet::Snapshot::Snapshot(details::Image && image)
+    : m_image(std::move(image))
+    , m_synset_ids(m_image.section<unsigned>(details::Section::SynsetIds))
+    , m_noun_blocks(m_image.section<unsigned>(details::Section::NounBlocks))
+    , m_noun_arena(m_image.section<char>(details::Section::NounArena))
+    , m_noun_synset_offsets(m_image.section<unsigned>(details::Section::NounSynsetOffsets))
+    , m_noun_synsets(m_image.section<unsigned>(details::Section::NounSynsets))
+    , m_gloss_offsets(m_image.section<unsigned>(details::Section::GlossOffsets))
+    , m_gloss_arena(m_image.section<char>(details::Section::GlossArena))
+    , m_synset_noun_offsets(m_image.section<unsigned>(details::Section::SynsetNounOffsets))
+    , m_synset_nouns(m_image.section<unsigned>(details::Section::SynsetNouns))
+    , m_commanc(image_graph(m_image))
+{
+    m_commanc.m_ancestor_offsets = m_image.section<unsigned>(details::Section::AncestorOffsets);
+    m_commanc.m_ancestors = m_image.section<details::AncestorEntry>(details::Section::Ancestors);
+}
+
+bool WordNet::Snapshot::is_patched() const
+{
+    return !m_added_ids.empty() || m_commanc.m_graph.is_patched();
+}
+
+details::Image WordNet::Snapshot::rebuild() const
+{
+    SynsetMap synset_map;
+    EdgeMap edge_map;
+    const Digraph & graph = m_commanc.m_graph;
+    for (unsigned vertex = 0; vertex < graph.size(); ++vertex) {
+        auto & synset = synset_map[synset_id(vertex)];
+        if (vertex < m_synset_ids.size()) {
+            for (unsigned i = m_synset_noun_offsets[vertex]; i < m_synset_noun_offsets[vertex + 1]; ++i) {
+                synset.first.push_back(noun(m_synset_nouns[i]));
+            }
+        }
+        else {
+            synset.first = m_synset_map.at(vertex).first;
+        }
+        synset.second = gloss(vertex);
+        for (const auto hypernym : graph.get(vertex)) {
+            edge_map[synset_id(vertex)].push_back(synset_id(hypernym));
+        }
+    }
+    return compile(synset_map, edge_map);
+}
+
+void WordNet::Snapshot::add_synset(unsigned id, const std::vector<std::string> & synonyms, const std::string & gloss)
+{
+    if (find_vertex(id)) {
+        throw std::invalid_argument("synset " + std::to_string(id) + " is in WordNet already");
+    }
+    const unsigned vertex = m_commanc.m_graph.add_vertex();
+    m_vertex_of.emplace(id, vertex);
+    m_added_ids.push_back(id);
+    m_synset_map.emplace(vertex, std::make_pair(synonyms, gloss));
+    for (const auto & word : synonyms) {
+        auto noun_id = find_noun(word);
+        if (!noun_id) {
+            noun_id = noun_count();
+            m_wordmap.emplace(word, *noun_id);
+            m_added_nouns.push_back(word);
+        }
+        const auto synsets = get_set_id(*noun_id);
+        auto [iter, inserted] = m_noun_synsets_patch.try_emplace(*noun_id, synsets.begin(), synsets.end());
+        iter->second.push_back(vertex);
+    }
+}
+
+void WordNet::Snapshot::add_hypernym(unsigned id, unsigned hypernym_id)
+{
+    const auto vertex = find_vertex(id);
+    const auto hypernym = find_vertex(hypernym_id);
+    if (!vertex || !hypernym) {
+        throw std::invalid_argument("synset " + std::to_string(vertex ? hypernym_id : id) + " is not in WordNet");
+    }
+    m_commanc.m_graph.push(*vertex, *hypernym);
+    // ancestors of the vertex and everything under it change
+    m_commanc.m_ancestor_offsets = {};
+    m_commanc.m_ancestors = {};
+}
+
+std::size_t WordNet::Snapshot::image_noun_count() const
+{
+    return m_noun_synset_offsets.empty() ? 0 : m_noun_synset_offsets.size() - 1;
+}
+
+std::size_t WordNet::Snapshot::noun_count() const
+{
+    return image_noun_count() + m_added_nouns.size();
+}
+
+// binary search over whole first nouns of blocks, then a scan of the front coded rest
+// keeping the length of prefix matched so far, so nothing is decoded into a buffer
+std::optional<unsigned> WordNet::Snapshot::find_image_noun(std::string_view word) const
+{
+    const auto head = [this](std::size_t block) {
+        std::size_t position = m_noun_blocks[block];
+        return get_noun(m_noun_arena, position).m_suffix;
+    };
+    std::size_t beg = 0, end = m_noun_blocks.empty() ? 0 : m_noun_blocks.size() - 1;
+    while (beg < end) {
+        const std::size_t mid = beg + (end - beg) / 2;
+        if (head(mid) <= word) {
+            beg = mid + 1;
+        }
+        else {
+            end = mid;
+        }
+    }
+    if (beg == 0) {
+        return std::nullopt;
+    }
+    const std::size_t block = beg - 1;
+
+    std::size_t position = m_noun_blocks[block];
+    std::size_t matched = 0;
+    for (unsigned index = block * details::noun_block_size; position < m_noun_blocks[block + 1]; ++index) {
+        const auto [prefix, suffix] = get_noun(m_noun_arena, position);
+        if (prefix < matched) { // differs from word earlier than the previous noun did, so it is greater
+            break;
+        }
+        if (prefix > matched) { // differs from word where the previous noun did, so it is still less
+            continue;
+        }
+        const std::string_view rest = word.substr(matched);
+        const auto common = std::mismatch(suffix.begin(), suffix.end(), rest.begin(), rest.end());
+        matched += common.first - suffix.begin();
+        if (common.first == suffix.end()) {
+            if (common.second == rest.end()) {
+                return index;
+            }
+            continue;
+        }
+        if (common.second == rest.end() || static_cast<unsigned char>(*common.first) > static_cast<unsigned char>(*common.second)) {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<unsigned> WordNet::Snapshot::find_noun(std::string_view word) const
+{
+    if (const auto index = find_image_noun(word)) {
+        return index;
+    }
+    if (m_wordmap.empty()) {
+        return std::nullopt;
+    }
+    const auto found = m_wordmap.find(std::string(word));
+    return found == m_wordmap.end() ? std::nullopt : std::optional<unsigned>(found->second);
+}
+
+std::string WordNet::Snapshot::noun(unsigned noun_id) const
+{
+    if (noun_id >= image_noun_count()) {
+        return m_added_nouns[noun_id - image_noun_count()];
+    }
+    std::string word;
+    std::size_t position = m_noun_blocks[noun_id / details::noun_block_size];
+    for (unsigned index = noun_id - noun_id % details::noun_block_size; index <= noun_id; ++index) {
+        const auto [prefix, suffix] = get_noun(m_noun_arena, position);
+        word.resize(prefix);
+        word.append(suffix);
+    }
+    return word;
+}
+
+unsigned WordNet::Snapshot::get_noun_id(const std::string & noun) const
+{
+    const auto index = find_noun(noun);
+    if (!index) {
+        throw std::out_of_range("noun is not in WordNet");
+    }
+    return *index;
+}
+
+std::span<const unsigned> WordNet::Snapshot::get_set_id(unsigned noun_id) const
+{
+    if (!m_noun_synsets_patch.empty()) {
+        if (const auto found = m_noun_synsets_patch.find(noun_id); found != m_noun_synsets_patch.end()) {
+            return found->second;
         }
     }
-    m_graph = std::move(dgrth);
-    m_commanc = ShortestCommonAncestor(m_graph); // NOLINT
+    if (noun_id >= image_noun_count()) {
+        return {};
+    }
+    return m_noun_synsets.subspan(m_noun_synset_offsets[noun_id], m_noun_synset_offsets[noun_id + 1] - m_noun_synset_offsets[noun_id]);
+}
+
+std::optional<unsigned> WordNet::Snapshot::find_vertex(unsigned id) const
+{
+    const auto found = std::lower_bound(m_synset_ids.begin(), m_synset_ids.end(), id);
+    if (found != m_synset_ids.end() && *found == id) {
+        return found - m_synset_ids.begin();
+    }
+    const auto added = m_vertex_of.find(id);
+    return added == m_vertex_of.end() ? std::nullopt : std::optional<unsigned>(added->second);
+}
+
+unsigned WordNet::Snapshot::synset_id(unsigned vertex) const
+{
+    return vertex < m_synset_ids.size() ? m_synset_ids[vertex] : m_added_ids[vertex - m_synset_ids.size()];
+}
+
+std::string_view WordNet::Snapshot::gloss(unsigned vertex) const
+{
+    if (vertex < m_synset_ids.size()) {
+        return {m_gloss_arena.data() + m_gloss_offsets[vertex], m_gloss_offsets[vertex + 1] - m_gloss_offsets[vertex]};
+    }
+    const auto added = m_synset_map.find(vertex);
+    if (added == m_synset_map.end()) {
+        throw std::out_of_range("synset is not in WordNet");
+    }
+    return added->second.second;
+}
+
+QueryCache::Result WordNet::Snapshot::search(const std::string & noun1, const std::string & noun2) const
+{
+    const unsigned id1 = get_noun_id(noun1);
+    const unsigned id2 = get_noun_id(noun2);
+    if (m_cache == nullptr) {
+        return m_commanc.search(get_set_id(id1), get_set_id(id2));
+    }
+    if (const auto cached = m_cache->get(id1, id2)) {
+        return *cached;
+    }
+    const auto result = m_commanc.search(get_set_id(id1), get_set_id(id2));
+    m_cache->put(id1, id2, result);
+    return result;
+}
+
+template <class Visit>
+void WordNet::Snapshot::for_each_synonym(unsigned vertex, Visit && visit) const
+{
+    if (vertex < m_synset_ids.size()) {
+        for (unsigned i = m_synset_noun_offsets[vertex]; i < m_synset_noun_offsets[vertex + 1]; ++i) {
+            visit(m_synset_nouns[i]);
+        }
+        return;
+    }
+    for (const auto & word : m_synset_map.at(vertex).first) {
+        visit(*find_noun(word));
+    }
+}
+
+// Wordnet section
+WordNet::WordNet(std::istream & synsets, std::istream & hypernyms)
+    : WordNet(parse(synsets, hypernyms))
+{
+}
+
+WordNet::WordNet(details::Image && image)
+    : m_snapshot(std::make_shared<const Snapshot>(std::move(image)))
+{
+}
+
+WordNet::WordNet(WordNet && other) noexcept
+    : m_snapshot(other.snapshot())
+{
+}
+
+WordNet & WordNet::operator=(WordNet && other) noexcept
+{
+    auto next = other.snapshot();
+    std::lock_guard lock(m_snapshot_mutex);
+    m_snapshot = std::move(next);
+    return *this;
+}
+
+std::shared_ptr<const WordNet::Snapshot> WordNet::snapshot() const
+{
+    std::lock_guard lock(m_snapshot_mutex);
+    return m_snapshot;
+}
+
+WordNet WordNet::load(const std::string & path, bool verify_checksum)
+{
+    return WordNet(details::Image::map_file(path, verify_checksum));
+}
+
+void WordNet::save(const std::string & path, bool with_ancestors) const
+{
+    const auto cur_snapshot = snapshot();
+    const details::Image image = cur_snapshot->is_patched() ? cur_snapshot->rebuild() : cur_snapshot->m_image;
+    if (image.section<unsigned>(details::Section::AncestorOffsets).empty() != with_ancestors) {
+        image.save(path);
+        return;
+    }
+    details::ImageWriter writer;
+    for (std::size_t i = 0; i < static_cast<std::size_t>(details::Section::AncestorOffsets); ++i) {
+        const auto section = static_cast<details::Section>(i);
+        writer.set(section, image.section<std::byte>(section));
+    }
+    if (with_ancestors) {
+        compile_ancestors(writer, image_graph(image));
+    }
+    details::Image(std::move(writer).finish()).save(path);
+}
+
+template <class Change>
+void WordNet::publish(Change && change)
+{
+    std::lock_guard lock(m_update_mutex);
+    auto next = std::make_shared<Snapshot>(*snapshot());
+    change(*next);
+    std::shared_ptr<const Snapshot> previous = std::move(next);
+    {
+        std::lock_guard snapshot_lock(m_snapshot_mutex);
+        m_snapshot.swap(previous);
+    }
+    // previous snapshot is released here or by the last query still running on it
+}
+
+void WordNet::Batch::add_synset(unsigned id, std::vector<std::string> synonyms, std::string gloss)
+{
+    m_synsets.push_back({id, std::move(synonyms), std::move(gloss)});
+}
+
+void WordNet::Batch::add_hypernym(unsigned id, unsigned hypernym_id)
+{
+    m_hypernyms.emplace_back(id, hypernym_id);
+}
+
+void WordNet::update(const Batch & batch)
+{
+    publish([&batch](Snapshot & snapshot) {
+        for (const auto & synset : batch.m_synsets) {
+            snapshot.add_synset(synset.id, synset.synonyms, synset.gloss);
+        }
+        for (const auto & [id, hypernym_id] : batch.m_hypernyms) {
+            snapshot.add_hypernym(id, hypernym_id);
+        }
+        if (snapshot.m_cache != nullptr) {
+            snapshot.m_cache = std::make_shared<QueryCache>(snapshot.m_cache->capacity());
+        }
+    });
+}
+
+void WordNet::add_synset(unsigned id, std::vector<std::string> synonyms, std::string gloss)
+{
+    Batch batch;
+    batch.add_synset(id, std::move(synonyms), std::move(gloss));
+    update(batch);
+}
+
+void WordNet::add_hypernym(unsigned id, unsigned hypernym_id)
+{
+    Batch batch;
+    batch.add_hypernym(id, hypernym_id);
+    update(batch);
 }
 
 WordNet::Nouns WordNet::nouns() const
 {
-    return Nouns(*this);
+    return Nouns(snapshot());
 }
 
 bool WordNet::is_noun(const std::string & word) const
 {
-    return m_wordmap.find(word) != m_wordmap.end();
+    return snapshot()->find_noun(word).has_value();
 }
 
 std::string WordNet::sca(const std::string & noun1, const std::string & noun2) const
 {
-    return m_synset_map.at(m_commanc.ancestor_subset(get_set_id(noun1), get_set_id(noun2))).second;
+    const auto cur_snapshot = snapshot();
+    return std::string(cur_snapshot->gloss(cur_snapshot->search(noun1, noun2).first));
 }
 
 unsigned WordNet::distance(const std::string & noun1, const std::string & noun2) const
 {
-    return m_commanc.length_subset(get_set_id(noun1), get_set_id(noun2));
+    return snapshot()->search(noun1, noun2).second;
+}
+
+// bfs over (vertex, direction) states: a path climbs hypernyms and then may only descend to hyponyms,
+// so the distance a vertex is reached at is the one 'distance' reports for its nouns
+std::vector<std::pair<std::string, unsigned>> WordNet::nearest(const std::string & noun, std::size_t k) const
+{
+    const auto cur_snapshot = snapshot();
+    const Digraph & graph = cur_snapshot->m_commanc.m_graph;
+    const unsigned noun_id = cur_snapshot->get_noun_id(noun);
+
+    std::vector<std::pair<std::string, unsigned>> result;
+    std::unordered_set<unsigned> seen_nouns{noun_id};
+    std::unordered_map<std::uint64_t, unsigned> info; // (vertex << 1 | is_descending) -> distance
+    std::vector<std::uint64_t> ids;
+    for (const auto id : cur_snapshot->get_set_id(noun_id)) {
+        if (info.try_emplace(static_cast<std::uint64_t>(id) << 1, 0).second) {
+            ids.push_back(static_cast<std::uint64_t>(id) << 1);
+        }
+    }
+    std::unordered_set<unsigned> seen_vertices;
+    for (std::size_t i = 0; i < ids.size() && result.size() < k; ++i) {
+        const auto state = ids[i];
+        const unsigned id = state >> 1;
+        const unsigned dist = info.at(state);
+        if (seen_vertices.insert(id).second) {
+            cur_snapshot->for_each_synonym(id, [&](unsigned synonym) {
+                if (result.size() < k && seen_nouns.insert(synonym).second) {
+                    result.emplace_back(cur_snapshot->noun(synonym), dist);
+                }
+            });
+        }
+        const auto visit = [&](unsigned next_id, bool is_descending) {
+            const auto next = static_cast<std::uint64_t>(next_id) << 1 | is_descending;
+            if (info.try_emplace(next, dist + 1).second) {
+                ids.push_back(next);
+            }
+        };
+        if ((state & 1) == 0) {
+            for (const auto id_h : graph.get(id)) {
+                visit(id_h, false);
+            }
+        }
+        for (const auto id_h : graph.get_reverse(id)) {
+            visit(id_h, true);
+        }
+    }
+    return result;
+}
+
+void WordNet::set_cache_capacity(std::size_t capacity)
+{
+    publish([capacity](Snapshot & snapshot) {
+        snapshot.m_cache = capacity == 0 ? nullptr : std::make_shared<QueryCache>(capacity);
+    });
 }
 
-std::set<unsigned> WordNet::get_set_id(const std::string & noun) const
+WordNet::CacheStats WordNet::cache_stats() const
 {
-    std::vector<unsigned> vec = m_wordmap.at(noun);
-    return {vec.begin(), vec.end()};
+    const auto cur_snapshot = snapshot();
+    if (cur_snapshot->m_cache == nullptr) {
+        return {0, 0};
+    }
+    return {cur_snapshot->m_cache->hits(), cur_snapshot->m_cache->misses()};
 }
 
 // Iterator in wn section
-const WordNet::Nouns::iterator::value_type & WordNet::Nouns::iterator::operator*() const { return m_iter->first; }
+WordNet::Nouns::iterator::iterator(const Nouns * _cur_nouns, bool _is_first)
+    : m_snapshot(_cur_nouns->m_snapshot)
+    , m_index(_is_first ? 0 : m_snapshot->noun_count())
+{
+    load_current();
+}
 
-WordNet::Nouns::iterator::pointer WordNet::Nouns::iterator::operator->() const { return &m_iter->first; }
+// decodes next noun over the current one
+void WordNet::Nouns::iterator::load_current()
+{
+    if (m_index < m_snapshot->image_noun_count()) {
+        const auto [prefix, suffix] = get_noun(m_snapshot->m_noun_arena, m_position);
+        m_current.resize(prefix);
+        m_current.append(suffix);
+    }
+    else if (m_index < m_snapshot->noun_count()) {
+        m_current = m_snapshot->m_added_nouns[m_index - m_snapshot->image_noun_count()];
+    }
+}
+
+const WordNet::Nouns::iterator::value_type & WordNet::Nouns::iterator::operator*() const { return m_current; }
+
+WordNet::Nouns::iterator::pointer WordNet::Nouns::iterator::operator->() const { return &m_current; }
 
 bool operator==(const WordNet::Nouns::iterator & a, const WordNet::Nouns::iterator & b)
 {
-    return a.m_iter == b.m_iter;
+    return a.m_snapshot == b.m_snapshot && a.m_index == b.m_index;
 }
 
 bool operator!=(const WordNet::Nouns::iterator & a, const WordNet::Nouns::iterator & b)
@@ -108,32 +777,152 @@ WordNet::Nouns::iterator WordNet::Nouns::iterator::operator++(int)
 
 WordNet::Nouns::iterator & WordNet::Nouns::iterator::operator++()
 {
-    ++m_iter;
+    ++m_index;
+    load_current();
     return *this;
 }
 
+// QueryCache section
+QueryCache::QueryCache(std::size_t capacity)
+    : m_capacity(capacity)
+    , m_used_shards(std::clamp<std::size_t>(capacity, 1, shard_count))
+{
+    for (std::size_t i = 0; i < m_used_shards; ++i) {
+        m_shards[i].m_capacity = capacity / m_used_shards + (i < capacity % m_used_shards);
+    }
+}
+
+std::size_t QueryCache::capacity() const
+{
+    return m_capacity;
+}
+
+std::uint64_t QueryCache::key(unsigned noun1, unsigned noun2)
+{
+    if (noun1 > noun2) {
+        std::swap(noun1, noun2);
+    }
+    return static_cast<std::uint64_t>(noun1) << 32 | noun2;
+}
+
+QueryCache::Shard & QueryCache::shard(std::uint64_t key)
+{
+    return m_shards[((key * 0x9e3779b97f4a7c15ull) >> 32) % m_used_shards];
+}
+
+std::optional<QueryCache::Result> QueryCache::get(unsigned noun1, unsigned noun2)
+{
+    const auto pair_key = key(noun1, noun2);
+    Shard & cur_shard = shard(pair_key);
+    std::lock_guard lock(cur_shard.m_mutex);
+    const auto found = cur_shard.m_index.find(pair_key);
+    if (found == cur_shard.m_index.end()) {
+        ++m_misses;
+        return std::nullopt;
+    }
+    ++m_hits;
+    cur_shard.m_order.splice(cur_shard.m_order.begin(), cur_shard.m_order, found->second);
+    return found->second->second;
+}
+
+void QueryCache::put(unsigned noun1, unsigned noun2, Result result)
+{
+    const auto pair_key = key(noun1, noun2);
+    Shard & cur_shard = shard(pair_key);
+    std::lock_guard lock(cur_shard.m_mutex);
+    const auto [found, inserted] = cur_shard.m_index.try_emplace(pair_key);
+    if (!inserted) { // another thread has just computed the same pair
+        found->second->second = result;
+        cur_shard.m_order.splice(cur_shard.m_order.begin(), cur_shard.m_order, found->second);
+        return;
+    }
+    cur_shard.m_order.emplace_front(pair_key, result);
+    found->second = cur_shard.m_order.begin();
+    if (cur_shard.m_order.size() > cur_shard.m_capacity) {
+        cur_shard.m_index.erase(cur_shard.m_order.back().first);
+        cur_shard.m_order.pop_back();
+    }
+}
+
+std::size_t QueryCache::hits() const
+{
+    return m_hits;
+}
+
+std::size_t QueryCache::misses() const
+{
+    return m_misses;
+}
+
 // Digraph section
 void Digraph::push(unsigned int _id, unsigned int _hypernym_id)
 {
-    const auto [it, inserted] = m_edges.emplace(_id, 0);
-    it->second.push_back(_hypernym_id);
+    m_hypernyms.push(_id, _hypernym_id);
+    m_hyponyms.push(_hypernym_id, _id);
+}
+
+unsigned Digraph::add_vertex()
+{
+    return m_hypernyms.image_size() + m_added++;
 }
 
-const std::vector<unsigned> & Digraph::get(unsigned int _id) const
+std::span<const unsigned> Digraph::get(unsigned int _id) const
 {
-    return m_edges.at(_id);
+    return m_hypernyms.get(_id);
+}
+
+std::span<const unsigned> Digraph::get_reverse(unsigned int _id) const
+{
+    return m_hyponyms.get(_id);
 }
 
 bool Digraph::is_in_graph(unsigned int _id) const
 {
-    return m_edges.find(_id) != m_edges.end();
+    return _id < size();
+}
+
+std::size_t Digraph::size() const
+{
+    return m_hypernyms.image_size() + m_added;
+}
+
+bool Digraph::is_patched() const
+{
+    return !m_hypernyms.m_patch.empty();
+}
+
+std::span<const unsigned> Digraph::Adjacency::get(unsigned int id) const
+{
+    if (!m_patch.empty()) {
+        if (const auto found = m_patch.find(id); found != m_patch.end()) {
+            return found->second;
+        }
+    }
+    if (id >= image_size()) {
+        return {};
+    }
+    return m_edges.subspan(m_offsets[id], m_offsets[id + 1] - m_offsets[id]);
+}
+
+void Digraph::Adjacency::push(unsigned int id, unsigned int to)
+{
+    const auto [it, inserted] = m_patch.try_emplace(id);
+    if (inserted && id < image_size()) {
+        it->second.assign(m_edges.begin() + m_offsets[id], m_edges.begin() + m_offsets[id + 1]);
+    }
+    it->second.push_back(to);
+}
+
+std::size_t Digraph::Adjacency::image_size() const
+{
+    return m_offsets.empty() ? 0 : m_offsets.size() - 1;
 }
 
 std::ostream & operator<<(std::ostream & stream, const Digraph & digraph)
 {
-    for (const auto & [id, edges] : digraph.m_edges) {
+    for (unsigned id = 0; id < digraph.size(); ++id) {
         stream << id << " -->";
-        for (const auto v_id : edges) {
+        for (const auto v_id : digraph.get(id)) {
             stream << " " << v_id;
         }
         stream << '\n';
@@ -142,76 +931,182 @@ std::ostream & operator<<(std::ostream & stream, const Digraph & digraph)
 }
 
 // ShortestCommonAncestor section
-std::pair<unsigned, unsigned> ShortestCommonAncestor::bfs(const std::set<unsigned int> & subset1, const std::set<unsigned int> & subset2) const
+std::pair<unsigned, unsigned> ShortestCommonAncestor::search(std::span<const unsigned> subset1, std::span<const unsigned> subset2) const
 {
-    std::unordered_map<unsigned, std::pair<bool, unsigned>> info;
+    return m_ancestor_offsets.empty() ? bfs(subset1, subset2) : lookup(subset1, subset2);
+}
+
+std::pair<unsigned, unsigned> ShortestCommonAncestor::bfs(std::span<const unsigned> subset1, std::span<const unsigned> subset2) const
+{
+    // distances of all ancestors of the first subset
+    std::unordered_map<unsigned, unsigned> info;
     std::vector<unsigned> ids;
     for (const auto id : subset1) {
-        info[id] = {true, 0};
+        info[id] = 0;
         ids.push_back(id);
     }
-    for (const auto id : subset2) {
-        if (info.find(id) != info.end()) {
-            return {id, 0};
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        const unsigned id = ids[i];
+        for (const auto id_h : m_graph.get(id)) {
+            if (info.try_emplace(id_h, info.at(id) + 1).second) {
+                ids.push_back(id_h);
+            }
         }
-        info[id] = {false, 0};
-        ids.push_back(id);
     }
+
+    // walk up from the second subset while it may still improve the answer
     std::pair<unsigned, unsigned> min_ancestor(static_cast<unsigned>(-1), static_cast<unsigned>(-1));
+    std::unordered_map<unsigned, unsigned> info2;
+    ids.clear();
+    for (const auto id : subset2) {
+        info2[id] = 0;
+        ids.push_back(id);
+    }
     for (std::size_t i = 0; i < ids.size(); ++i) {
-        unsigned id = ids[i];
-        if (!m_graph->is_in_graph(id)) {
-            continue;
+        const unsigned id = ids[i];
+        const unsigned dist = info2.at(id);
+        if (dist > min_ancestor.second) {
+            break;
         }
-        bool is_first_noun = info.at(id).first;
-        for (const auto id_h : m_graph->get(id)) {
-            auto [iter, inserted] = info.try_emplace(id_h);
-            if (inserted) {
+        if (const auto found = info.find(id); found != info.end()) {
+            const std::pair<unsigned, unsigned> candidate(found->second + dist, id);
+            if (candidate < std::make_pair(min_ancestor.second, min_ancestor.first)) {
+                min_ancestor = {id, candidate.first};
+            }
+        }
+        for (const auto id_h : m_graph.get(id)) {
+            if (info2.try_emplace(id_h, dist + 1).second) {
                 ids.push_back(id_h);
-                iter->second = {is_first_noun, info.at(id).second + 1};
+            }
+        }
+    }
+
+    return min_ancestor;
+}
+
+std::pair<unsigned, unsigned> ShortestCommonAncestor::lookup(std::span<const unsigned> subset1, std::span<const unsigned> subset2) const
+{
+    return intersect(ancestors(subset1), ancestors(subset2));
+}
+
+std::vector<details::AncestorEntry> ShortestCommonAncestor::ancestors(std::span<const unsigned> subset) const
+{
+    std::vector<details::AncestorEntry> entries;
+    if (!m_ancestor_offsets.empty()) {
+        for (const auto id : subset) {
+            if (id + 1 >= m_ancestor_offsets.size()) { // added after the image was built, has no hypernyms yet
+                entries.push_back({id, 0});
                 continue;
             }
-            if (iter->second.first != is_first_noun) {
-                unsigned sum = iter->second.second + info.at(id).second + 1; //
-                if (sum < min_ancestor.second) {
-                    min_ancestor = {id_h, sum};
-                }
+            const auto beg = m_ancestors.begin() + m_ancestor_offsets[id];
+            entries.insert(entries.end(), beg, m_ancestors.begin() + m_ancestor_offsets[id + 1]);
+        }
+        std::sort(entries.begin(), entries.end(), [](const auto & a, const auto & b) {
+            return a.m_vertex < b.m_vertex || (a.m_vertex == b.m_vertex && a.m_distance < b.m_distance);
+        });
+        entries.erase(std::unique(entries.begin(), entries.end(), [](const auto & a, const auto & b) {
+                          return a.m_vertex == b.m_vertex;
+                      }),
+                      entries.end());
+        return entries;
+    }
+
+    // multi-source bfs, every vertex is reached first with its least distance
+    std::unordered_map<unsigned, unsigned> info;
+    for (const auto id : subset) {
+        if (info.try_emplace(id, 0).second) {
+            entries.push_back({id, 0});
+        }
+    }
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const auto [id, dist] = entries[i];
+        for (const auto id_h : m_graph.get(id)) {
+            if (info.try_emplace(id_h, dist + 1).second) {
+                entries.push_back({id_h, dist + 1});
             }
         }
     }
+    std::sort(entries.begin(), entries.end(), [](const auto & a, const auto & b) {
+        return a.m_vertex < b.m_vertex;
+    });
+    return entries;
+}
 
+std::pair<unsigned, unsigned> ShortestCommonAncestor::intersect(const std::vector<details::AncestorEntry> & entries1, const std::vector<details::AncestorEntry> & entries2)
+{
+    std::pair<unsigned, unsigned> min_ancestor(static_cast<unsigned>(-1), static_cast<unsigned>(-1));
+    for (auto it1 = entries1.begin(), it2 = entries2.begin(); it1 != entries1.end() && it2 != entries2.end();) {
+        if (it1->m_vertex < it2->m_vertex) {
+            ++it1;
+        }
+        else if (it2->m_vertex < it1->m_vertex) {
+            ++it2;
+        }
+        else {
+            const unsigned sum = it1->m_distance + it2->m_distance;
+            if (sum < min_ancestor.second) { // ties resolve to the least vertex as in bfs
+                min_ancestor = {it1->m_vertex, sum};
+            }
+            ++it1;
+            ++it2;
+        }
+    }
     return min_ancestor;
 }
-unsigned ShortestCommonAncestor::ancestor_subset(const std::set<unsigned int> & subset_a, const std::set<unsigned int> & subset_b) const
+
+unsigned ShortestCommonAncestor::ancestor_subset(std::span<const unsigned> subset_a, std::span<const unsigned> subset_b) const
 {
-    return bfs(subset_a, subset_b).first;
+    return search(subset_a, subset_b).first;
 }
 
-unsigned ShortestCommonAncestor::length_subset(const std::set<unsigned int> & subset_a, const std::set<unsigned int> & subset_b) const
+unsigned ShortestCommonAncestor::length_subset(std::span<const unsigned> subset_a, std::span<const unsigned> subset_b) const
 {
-    return bfs(subset_a, subset_b).second;
+    return search(subset_a, subset_b).second;
 }
 
 unsigned ShortestCommonAncestor::ancestor(unsigned int v, unsigned int w)
 {
-    return bfs({v}, {w}).first;
+    return search({&v, 1}, {&w, 1}).first;
 }
 
 unsigned ShortestCommonAncestor::length(unsigned int v, unsigned int w)
 {
-    return bfs({v}, {w}).second;
+    return search({&v, 1}, {&w, 1}).second;
 }
 
 // Outcast section
+// ancestors of every noun are found once (in parallel) and each pair is a merge of two sorted lists
 std::string Outcast::outcast(const std::set<std::string> & nouns)
 {
+    const auto snapshot = m_wordnet.snapshot();
+    std::vector<unsigned> noun_ids;
+    for (const auto & noun : nouns) {
+        noun_ids.push_back(snapshot->get_noun_id(noun));
+    }
+
+    std::vector<std::vector<details::AncestorEntry>> ancestors(nouns.size());
+    std::atomic<std::size_t> next = 0;
+    const auto worker = [&]() {
+        for (std::size_t i = next++; i < ancestors.size(); i = next++) {
+            ancestors[i] = snapshot->m_commanc.ancestors(snapshot->get_set_id(noun_ids[i]));
+        }
+    };
+    // starting a thread costs more than a few ancestor walks, small sets are done by the calling thread alone
+    constexpr std::size_t nouns_per_thread = 64;
+    const std::size_t thread_count = std::min<std::size_t>(std::thread::hardware_concurrency(), nouns.size() / nouns_per_thread);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
     std::vector<unsigned> sums(nouns.size(), 0);
-    std::vector<std::vector<unsigned>> results(nouns.size());
-    unsigned cnt1 = 0;
-    for (auto iter1 = nouns.begin(); iter1 != nouns.end(); ++iter1, ++cnt1) {
-        unsigned cnt2 = 0;
-        for (auto iter2 = nouns.begin(); iter2 != iter1; ++iter2, ++cnt2) {
-            auto distance = m_wordnet.distance(*iter1, *iter2);
+    for (std::size_t cnt1 = 0; cnt1 < nouns.size(); ++cnt1) {
+        for (std::size_t cnt2 = 0; cnt2 < cnt1; ++cnt2) {
+            auto distance = ShortestCommonAncestor::intersect(ancestors[cnt1], ancestors[cnt2]).second;
             sums[cnt1] += distance;
             sums[cnt2] += distance;
         }
@@ -231,4 +1126,4 @@ std::string Outcast::outcast(const std::set<std::string> & nouns)
         }
     }
     return is_repeated ? "" : *max_iter;
-}
\ No newline at end of file
+}
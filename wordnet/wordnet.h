@@ -1,42 +1,106 @@
+#pragma once
+
+#include "image.h"
+
+#include <atomic>
+#include <cstdint>
 #include <iosfwd>
 #include <iostream>
 #include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+// hypernym edges stored as adjacency arrays over dense vertex numbers, in both directions
 class Digraph
 {
 public:
+    Digraph() = default;
+
+    Digraph(std::span<const unsigned> offsets, std::span<const unsigned> edges, std::span<const unsigned> reverse_offsets, std::span<const unsigned> reverse_edges)
+        : m_hypernyms{offsets, edges, {}}
+        , m_hyponyms{reverse_offsets, reverse_edges, {}}
+    {
+    }
+
+    // adds edge over the image, adjacency lists of both ends are copied out of it on the first change
     void push(unsigned _id, unsigned _hypernym_id);
 
-    const std::vector<unsigned> & get(unsigned _id) const;
+    // appends vertex without edges, returns its number
+    unsigned add_vertex();
+
+    // hypernyms of '_id'
+    std::span<const unsigned> get(unsigned _id) const;
+
+    // hyponyms of '_id'
+    std::span<const unsigned> get_reverse(unsigned _id) const;
 
     bool is_in_graph(unsigned _id) const;
 
+    // number of vertices
+    std::size_t size() const;
+
+    // 'true' if edges were pushed after the image was built
+    bool is_patched() const;
+
     friend std::ostream & operator<<(std::ostream & stream, const Digraph & digraph);
 
 private:
-    std::unordered_map<unsigned, std::vector<unsigned>> m_edges;
+    struct Adjacency
+    {
+        std::span<const unsigned> m_offsets;
+        std::span<const unsigned> m_edges;
+        std::unordered_map<unsigned, std::vector<unsigned>> m_patch; // lists changed after the image was built
+
+        std::span<const unsigned> get(unsigned id) const;
+        void push(unsigned id, unsigned to);
+        std::size_t image_size() const;
+    };
+
+    Adjacency m_hypernyms;
+    Adjacency m_hyponyms;
+    std::size_t m_added = 0;
 };
 
 class ShortestCommonAncestor
 {
     friend class WordNet;
+    friend class Outcast;
 
 private:
-    const Digraph * m_graph;
+    Digraph m_graph;
+    // optional precomputed ancestors of every vertex, empty if image has no ancestor index
+    std::span<const unsigned> m_ancestor_offsets;
+    std::span<const details::AncestorEntry> m_ancestors;
 
     ShortestCommonAncestor() = default;
 
     explicit ShortestCommonAncestor(const Digraph & dg)
-        : m_graph(&dg)
+        : m_graph(dg)
     {
     }
 
-    std::pair<unsigned, unsigned> bfs(const std::set<unsigned> & subset1, const std::set<unsigned> & subset2) const;
+    // returns pair of ancestor and length
+    std::pair<unsigned, unsigned> search(std::span<const unsigned> subset1, std::span<const unsigned> subset2) const;
+
+    std::pair<unsigned, unsigned> bfs(std::span<const unsigned> subset1, std::span<const unsigned> subset2) const;
+
+    // intersects ancestors of both subsets
+    std::pair<unsigned, unsigned> lookup(std::span<const unsigned> subset1, std::span<const unsigned> subset2) const;
+
+    // all ancestors of subset (itself included) with the least distance, sorted by vertex
+    std::vector<details::AncestorEntry> ancestors(std::span<const unsigned> subset) const;
+
+    // common ancestor of two 'ancestors' lists with the least sum of distances
+    static std::pair<unsigned, unsigned> intersect(const std::vector<details::AncestorEntry> & entries1, const std::vector<details::AncestorEntry> & entries2);
 
     // calculates length of shortest common ancestor path from node with id 'v' to node with id 'w'
     unsigned length(unsigned v, unsigned w);
@@ -45,17 +109,69 @@ private:
     unsigned ancestor(unsigned v, unsigned w);
 
     // calculates length of shortest common ancestor path from node subset 'subset_a' to node subset 'subset_b'
-    unsigned length_subset(const std::set<unsigned> & subset_a, const std::set<unsigned> & subset_b) const;
+    unsigned length_subset(std::span<const unsigned> subset_a, std::span<const unsigned> subset_b) const;
 
     // returns node id of shortest common ancestor of node subset 'subset_a' and node subset 'subset_b'
-    unsigned ancestor_subset(const std::set<unsigned> & subset_a, const std::set<unsigned> & subset_b) const;
+    unsigned ancestor_subset(std::span<const unsigned> subset_a, std::span<const unsigned> subset_b) const;
+};
+
+// bounded LRU of search results keyed by unordered pair of noun ids, safe to share between threads
+class QueryCache
+{
+public:
+    // ancestor and length
+    using Result = std::pair<unsigned, unsigned>;
+
+    explicit QueryCache(std::size_t capacity);
+
+    std::size_t capacity() const;
+
+    std::optional<Result> get(unsigned noun1, unsigned noun2);
+
+    void put(unsigned noun1, unsigned noun2, Result result);
+
+    std::size_t hits() const;
+    std::size_t misses() const;
+
+private:
+    // pairs are spread over independently locked shards to keep threads from contending,
+    // capacities of used shards sum up to the capacity of the cache
+    static constexpr std::size_t shard_count = 16;
+
+    struct Shard
+    {
+        std::size_t m_capacity = 0;
+        std::mutex m_mutex;
+        std::list<std::pair<std::uint64_t, Result>> m_order; // most recently used first
+        std::unordered_map<std::uint64_t, std::list<std::pair<std::uint64_t, Result>>::iterator> m_index;
+    };
+
+    const std::size_t m_capacity;
+    const std::size_t m_used_shards; // fewer than shard_count for capacities below it
+    Shard m_shards[shard_count];
+    std::atomic<std::size_t> m_hits = 0;
+    std::atomic<std::size_t> m_misses = 0;
+
+    static std::uint64_t key(unsigned noun1, unsigned noun2);
+    Shard & shard(std::uint64_t key);
 };
 
 class WordNet
 {
+    friend class Outcast;
+
+    // immutable state queries run on, 'update' publishes a patched copy
+    struct Snapshot;
+
 public:
     WordNet(std::istream & synsets, std::istream & hypernyms);
 
+    WordNet(WordNet && other) noexcept;
+    WordNet & operator=(WordNet && other) noexcept;
+
+    // maps image written by 'save', throws std::runtime_error if it is stale or damaged
+    static WordNet load(const std::string & path, bool verify_checksum = true);
+
     class Nouns
     {
         friend class WordNet;
@@ -88,12 +204,14 @@ public:
             friend bool operator!=(const iterator & a, const iterator & b);
 
         private:
-            std::unordered_map<std::string, std::vector<unsigned>>::const_iterator m_iter;
+            std::shared_ptr<const Snapshot> m_snapshot;
+            unsigned m_index = 0;
+            std::size_t m_position = 0; // of the next front coded noun in arena
+            std::string m_current;
 
-            iterator(const Nouns * _cur_nouns, bool _is_first = false)
-                : m_iter(_is_first ? _cur_nouns->m_wordmap.begin() : _cur_nouns->m_wordmap.end())
-            {
-            }
+            iterator(const Nouns * _cur_nouns, bool _is_first = false);
+
+            void load_current();
         };
 
         iterator begin() const
@@ -106,13 +224,43 @@ public:
         }
 
     private:
-        const std::unordered_map<std::string, std::vector<unsigned>> & m_wordmap;
-        Nouns(const WordNet & wordnet)
-            : m_wordmap(wordnet.m_wordmap)
+        std::shared_ptr<const Snapshot> m_snapshot;
+        Nouns(std::shared_ptr<const Snapshot> snapshot)
+            : m_snapshot(std::move(snapshot))
         {
         }
     };
 
+    // changes applied together by 'update'
+    class Batch
+    {
+        friend class WordNet;
+
+    public:
+        void add_synset(unsigned id, std::vector<std::string> synonyms, std::string gloss);
+
+        void add_hypernym(unsigned id, unsigned hypernym_id);
+
+    private:
+        struct Synset
+        {
+            unsigned id;
+            std::vector<std::string> synonyms;
+            std::string gloss;
+        };
+
+        std::vector<Synset> m_synsets;
+        std::vector<std::pair<unsigned, unsigned>> m_hypernyms;
+    };
+
+    // applies whole batch, queries running meanwhile keep seeing the previous state
+    // throws std::invalid_argument and applies nothing if a synset exists already or an edge refers to unknown one
+    void update(const Batch & batch);
+
+    void add_synset(unsigned id, std::vector<std::string> synonyms, std::string gloss);
+
+    void add_hypernym(unsigned id, unsigned hypernym_id);
+
     // lists all nouns stored in WordNet
     Nouns nouns() const;
 
@@ -125,13 +273,37 @@ public:
     // calculates distance between noun1 and noun2
     unsigned distance(const std::string & noun1, const std::string & noun2) const;
 
+    // up to 'k' nouns closest to 'noun' (itself excluded) with their distances, nearest first
+    std::vector<std::pair<std::string, unsigned>> nearest(const std::string & noun, std::size_t k) const;
+
+    // writes position independent image for 'load', 'with_ancestors' adds ancestor index of every synset
+    void save(const std::string & path, bool with_ancestors = false) const;
+
+    struct CacheStats
+    {
+        std::size_t hits;
+        std::size_t misses;
+    };
+
+    // memoizes distance and sca of up to 'capacity' noun pairs, 0 turns the cache off
+    void set_cache_capacity(std::size_t capacity);
+
+    // counted since the last change of WordNet, every change starts an empty cache
+    CacheStats cache_stats() const;
+
 private:
-    std::unordered_map<unsigned, std::pair<std::vector<std::string>, std::string>> m_synset_map;
-    std::unordered_map<std::string, std::vector<unsigned>> m_wordmap;
-    Digraph m_graph;
-    ShortestCommonAncestor m_commanc;
+    // readers only take a reference to the current snapshot under the lock, so writers never wait for queries
+    mutable std::mutex m_snapshot_mutex;
+    std::shared_ptr<const Snapshot> m_snapshot;
+    std::mutex m_update_mutex; // writers publish one by one
+
+    explicit WordNet(details::Image && image);
+
+    std::shared_ptr<const Snapshot> snapshot() const;
 
-    std::set<unsigned> get_set_id(const std::string & noun) const;
+    // publishes copy of the current snapshot changed by 'change'
+    template <class Change>
+    void publish(Change && change);
 };
 
 class Outcast